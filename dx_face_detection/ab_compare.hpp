@@ -0,0 +1,153 @@
+/*
+// Copyright (c) 2018 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma once
+
+#include <string>
+#include <vector>
+#include <map>
+#include <utility>
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+
+#include <samples/slog.hpp>
+
+#include "results_writer.hpp"
+#include "box_utils.hpp"
+
+/**
+* \brief Pairs detections of two runs on the same frame, see matchBoxes
+*/
+inline std::vector<std::pair<size_t, size_t>> matchDetections(const std::vector<FaceRecord> &a,
+                                                              const std::vector<FaceRecord> &b, float minIou) {
+    std::vector<cv::Rect> boxesA, boxesB;
+    for (auto &&face : a) {
+        boxesA.push_back(face.location);
+    }
+    for (auto &&face : b) {
+        boxesB.push_back(face.location);
+    }
+    return matchBoxes(boxesA, boxesB, minIou);
+}
+
+/**
+* \brief Accumulates how much a variant B of the networks (e.g. FP16 or INT8 models) differs from
+* variant A on the same frames: inference time per network and drift of detections and attributes.
+*/
+class PrecisionComparison {
+public:
+    struct Drift {
+        size_t count = 0;
+        double sumAbs = 0;
+        double maxAbs = 0;
+
+        void add(double difference) {
+            count++;
+            sumAbs += std::fabs(difference);
+            maxAbs = std::max(maxAbs, std::fabs(difference));
+        }
+        double meanAbs() const {
+            return count ? sumAbs / count : 0;
+        }
+    };
+
+    explicit PrecisionComparison(float minIou = 0.5f) : _minIou(minIou) {}
+
+    void addTiming(const std::string &network, double msA, double msB) {
+        Timing &timing = _timings[network];
+        timing.samples++;
+        timing.totalMsA += msA;
+        timing.totalMsB += msB;
+    }
+
+    /** Compares the detections of one frame, returns the matched pairs for attribute comparison **/
+    std::vector<std::pair<size_t, size_t>> addDetections(const std::vector<FaceRecord> &a, const std::vector<FaceRecord> &b) {
+        std::vector<std::pair<size_t, size_t>> matches = matchDetections(a, b, _minIou);
+        _detectionsA += a.size();
+        _detectionsB += b.size();
+        for (auto &&match : matches) {
+            _iou.add(1.0 - intersectionOverUnion(a[match.first].location, b[match.second].location));
+            _confidence.add(a[match.first].confidence - b[match.second].confidence);
+        }
+        _matched += matches.size();
+        return matches;
+    }
+
+    /** Compares the attributes both variants produced for the same face **/
+    void addAttributes(const FaceRecord &a, const FaceRecord &b) {
+        if (a.hasAgeGender && b.hasAgeGender) {
+            _age.add(a.age - b.age);
+            _maleProb.add(a.maleProb - b.maleProb);
+            _genderFlips += (a.maleProb > 0.5f) != (b.maleProb > 0.5f) ? 1 : 0;
+        }
+        if (a.hasHeadPose && b.hasHeadPose) {
+            _yaw.add(a.yaw - b.yaw);
+            _pitch.add(a.pitch - b.pitch);
+            _roll.add(a.roll - b.roll);
+        }
+    }
+
+    void print() const {
+        slog::info << "   Precision comparison, variant A vs variant B:" << slog::endl;
+        for (auto &&timing : _timings) {
+            const Timing &t = timing.second;
+            slog::info << "     " << std::left << std::setw(16) << timing.first << std::right << std::fixed
+                       << std::setprecision(2) << t.totalMsA / t.samples << " ms -> " << t.totalMsB / t.samples
+                       << " ms per frame, speedup " << (t.totalMsB > 0 ? t.totalMsA / t.totalMsB : 0.0) << "x" << slog::endl;
+        }
+        if (_detectionsA + _detectionsB > 0) {
+            slog::info << "     Detections: " << _detectionsA << " in A, " << _detectionsB << " in B, " << _matched
+                       << " matched at IoU >= " << _minIou << " (" << _detectionsA - _matched << " only in A, "
+                       << _detectionsB - _matched << " only in B)" << slog::endl;
+            slog::info << "       mean 1-IoU " << std::setprecision(4) << _iou.meanAbs() << ", max " << _iou.maxAbs
+                       << "; confidence mean abs diff " << _confidence.meanAbs() << ", max " << _confidence.maxAbs << slog::endl;
+        }
+        if (_age.count > 0) {
+            slog::info << "     Age Gender on " << _age.count << " faces: age mean abs error " << std::setprecision(2)
+                       << _age.meanAbs() << " years, max " << _age.maxAbs << "; " << _genderFlips << " gender flips ("
+                       << 100.0 * _genderFlips / _age.count << "%), male probability mean abs diff "
+                       << std::setprecision(4) << _maleProb.meanAbs() << slog::endl;
+        }
+        if (_yaw.count > 0) {
+            slog::info << "     Head Pose on " << _yaw.count << " faces: mean abs error yaw " << std::setprecision(3)
+                       << _yaw.meanAbs() << ", pitch " << _pitch.meanAbs() << ", roll " << _roll.meanAbs()
+                       << " degrees; max " << std::max(_yaw.maxAbs, std::max(_pitch.maxAbs, _roll.maxAbs)) << slog::endl;
+        }
+    }
+
+private:
+    struct Timing {
+        size_t samples = 0;
+        double totalMsA = 0;
+        double totalMsB = 0;
+    };
+
+    const float _minIou;
+    std::map<std::string, Timing> _timings;
+    size_t _detectionsA = 0;
+    size_t _detectionsB = 0;
+    size_t _matched = 0;
+    Drift _iou;
+    Drift _confidence;
+    Drift _age;
+    Drift _maleProb;
+    size_t _genderFlips = 0;
+    Drift _yaw;
+    Drift _pitch;
+    Drift _roll;
+};
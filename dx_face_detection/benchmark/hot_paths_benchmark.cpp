@@ -0,0 +1,224 @@
+/*
+// Copyright (c) 2018 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+
+/**
+* \brief Microbenchmarks of the per-frame CPU work of face_detection_tutorial outside inference:
+* matU8ToBlob into U8 and FP32 blobs, parsing of the DetectionOutput blob, face cropping and
+* drawing of head pose axes, on synthetic frames and detection blobs. No models or video needed.
+*
+* Usage: face_detection_benchmark [samples (default 30)] [minimum ms per sample (default 5)] [filter]
+* Every case is repeated often enough for a sample to take the minimum time, statistics are per call.
+* Only cases whose name contains filter are run.
+*/
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <numeric>
+#include <chrono>
+#include <cmath>
+#include <functional>
+
+#include <inference_engine.hpp>
+#include <samples/common.hpp>
+#include <opencv2/opencv.hpp>
+
+#include "../detection_utils.hpp"
+
+using namespace InferenceEngine;
+
+struct Options {
+    size_t samples = 30;
+    double minSampleMs = 5;
+    std::string filter;
+};
+
+/** Keeps the compiler from dropping results of the measured code **/
+static volatile size_t sink = 0;
+
+static void runCase(const Options &options, const std::string &name, const std::function<void()> &body) {
+    if (name.find(options.filter) == std::string::npos) {
+        return;
+    }
+    typedef std::chrono::duration<double, std::micro> us;
+    auto timeIterations = [&](size_t iterations) {
+        auto start = std::chrono::high_resolution_clock::now();
+        for (size_t i = 0; i < iterations; i++) {
+            body();
+        }
+        return std::chrono::duration_cast<us>(std::chrono::high_resolution_clock::now() - start).count();
+    };
+
+    // warm up caches and calibrate the number of calls per sample
+    size_t iterations = 1;
+    while (timeIterations(iterations) < options.minSampleMs * 1000 && iterations < (1u << 24)) {
+        iterations *= 2;
+    }
+
+    std::vector<double> perCall;
+    for (size_t s = 0; s < options.samples; s++) {
+        perCall.push_back(timeIterations(iterations) / iterations);
+    }
+    std::sort(perCall.begin(), perCall.end());
+    const double mean = std::accumulate(perCall.begin(), perCall.end(), 0.0) / perCall.size();
+    double variance = 0;
+    for (double value : perCall) {
+        variance += (value - mean) * (value - mean);
+    }
+    const double stddev = std::sqrt(variance / perCall.size());
+
+    std::cout << std::left << std::setw(48) << name << std::right << std::fixed << std::setprecision(2)
+              << std::setw(12) << perCall[perCall.size() / 2] << std::setw(12) << perCall.front()
+              << std::setw(12) << perCall[std::min(perCall.size() - 1, perCall.size() * 9 / 10)]
+              << std::setw(12) << mean << std::setw(8) << std::setprecision(1) << 100.0 * stddev / mean << "%"
+              << std::setw(10) << iterations << std::endl;
+}
+
+/** NCHW blob over memory owned by the caller, like the input blobs of the networks **/
+template <typename T>
+static Blob::Ptr makeInputBlob(std::vector<T> &memory, Precision precision, size_t batch, const cv::Size &size) {
+    memory.assign(batch * 3 * size.area(), 0);
+    return make_shared_blob<T>(TensorDesc(precision, {batch, 3, static_cast<size_t>(size.height),
+                                                      static_cast<size_t>(size.width)}, Layout::NCHW), memory.data());
+}
+
+static cv::Mat syntheticFrame(const cv::Size &size) {
+    cv::Mat frame(size, CV_8UC3);
+    cv::randu(frame, cv::Scalar::all(0), cv::Scalar::all(255));
+    return frame;
+}
+
+/** Faces spread over the frame in a grid, each about faceSize pixels wide **/
+static std::vector<cv::Rect> syntheticFaces(const cv::Size &frame, size_t count, int faceSize) {
+    std::vector<cv::Rect> faces;
+    const int cols = static_cast<int>(std::ceil(std::sqrt(static_cast<double>(count))));
+    for (size_t i = 0; i < count; i++) {
+        const int x = (frame.width - faceSize) * static_cast<int>(i % cols) / std::max(1, cols - 1);
+        const int y = (frame.height - faceSize) * static_cast<int>(i / cols) / std::max(1, cols - 1);
+        faces.push_back(cv::Rect(x - faceSize / 8, y, faceSize, faceSize));  // partly outside on the left border
+    }
+    return faces;
+}
+
+/** DetectionOutput blob with count detections, every second one above a 0.5 threshold **/
+static std::vector<float> syntheticDetections(int maxProposalCount, int count) {
+    std::vector<float> blob(maxProposalCount * 7, 0.f);
+    for (int i = 0; i < maxProposalCount; i++) {
+        float *d = &blob[i * 7];
+        if (i >= count) {
+            d[0] = -1;  // end of detections
+            break;
+        }
+        const float x = (i % 10) / 10.f, y = (i / 10 % 10) / 10.f;
+        d[0] = 0;
+        d[1] = 1;
+        d[2] = i % 2 ? 0.3f : 0.9f;
+        d[3] = x;
+        d[4] = y;
+        d[5] = x + 0.08f;
+        d[6] = y + 0.1f;
+    }
+    return blob;
+}
+
+int main(int argc, char *argv[]) {
+    Options options;
+    if (argc > 1) options.samples = std::max(1ul, std::stoul(argv[1]));
+    if (argc > 2) options.minSampleMs = std::stod(argv[2]);
+    if (argc > 3) options.filter = argv[3];
+    cv::setNumThreads(1);  // cv::resize would otherwise measure the OpenCV thread pool
+
+    std::cout << std::left << std::setw(48) << "case (times in us per call)" << std::right << std::setw(12) << "median"
+              << std::setw(12) << "min" << std::setw(12) << "p90" << std::setw(12) << "mean" << std::setw(9) << "rsd"
+              << std::setw(10) << "calls" << std::endl;
+
+    // whole frames into the face detector input, U8 as used by the detector and FP32 for comparison
+    const cv::Size detectorInput(300, 300);
+    for (const cv::Size &frameSize : {cv::Size(640, 480), cv::Size(1280, 720), cv::Size(1920, 1080), cv::Size(3840, 2160)}) {
+        const cv::Mat frame = syntheticFrame(frameSize);
+        const std::string size = std::to_string(frameSize.width) + "x" + std::to_string(frameSize.height);
+        std::vector<uint8_t> u8;
+        Blob::Ptr u8Blob = makeInputBlob(u8, Precision::U8, 1, detectorInput);
+        runCase(options, "matU8ToBlob<uint8_t> " + size + " -> 300x300", [&] {
+            matU8ToBlob<uint8_t>(frame, u8Blob);
+            sink += u8[0];
+        });
+        std::vector<float> fp32;
+        Blob::Ptr fp32Blob = makeInputBlob(fp32, Precision::FP32, 1, detectorInput);
+        runCase(options, "matU8ToBlob<float> " + size + " -> 300x300", [&] {
+            matU8ToBlob<float>(frame, fp32Blob);
+            sink += static_cast<size_t>(fp32[0]);
+        });
+    }
+
+    // face crops into the 62x62 Age Gender input, a batch of 16 faces
+    for (int faceSize : {32, 96, 256}) {
+        const cv::Mat face = syntheticFrame(cv::Size(faceSize, faceSize));
+        const std::string size = std::to_string(faceSize) + "x" + std::to_string(faceSize);
+        std::vector<float> fp32;
+        Blob::Ptr fp32Blob = makeInputBlob(fp32, Precision::FP32, 16, cv::Size(62, 62));
+        runCase(options, "matU8ToBlob<float> face " + size + " -> 62x62", [&] {
+            matU8ToBlob<float>(face, fp32Blob, 7);
+            sink += static_cast<size_t>(fp32[0]);
+        });
+        std::vector<uint8_t> u8;
+        Blob::Ptr u8Blob = makeInputBlob(u8, Precision::U8, 16, cv::Size(62, 62));
+        runCase(options, "matU8ToBlob<uint8_t> face " + size + " -> 62x62", [&] {
+            matU8ToBlob<uint8_t>(face, u8Blob, 7);
+            sink += u8[0];
+        });
+    }
+
+    // DetectionOutput of face-detection-retail (200 proposals of 7 values)
+    const std::vector<cv::Size> frameSizes = {cv::Size(1920, 1080)};
+    for (int count : {1, 10, 50, 200}) {
+        const std::vector<float> blob = syntheticDetections(200, count);
+        std::vector<DetectionResult> results;
+        runCase(options, "parseDetectionOutput " + std::to_string(count) + " of 200 proposals", [&] {
+            results.clear();
+            parseDetectionOutput(blob.data(), 200, 7, 1, frameSizes, 0.5f, results);
+            sink += results.size();
+        });
+    }
+
+    // face crops and head pose axes on a 1080p frame
+    const cv::Mat frame = syntheticFrame(cv::Size(1920, 1080));
+    for (size_t count : {1, 10, 50}) {
+        const std::vector<cv::Rect> faces = syntheticFaces(frame.size(), count, 120);
+        std::vector<cv::Mat> crops;
+        runCase(options, "cropFace " + std::to_string(count) + " faces 1920x1080", [&] {
+            crops.clear();
+            for (auto &&face : faces) {
+                crops.push_back(cropFace(frame, face));
+            }
+            sink += crops.size();
+        });
+    }
+    const cv::Mat cameraMatrix = makeCameraMatrix(frame.cols / 2, frame.rows / 2, 950.0f);
+    for (size_t count : {1, 10, 50}) {
+        const std::vector<cv::Rect> faces = syntheticFaces(frame.size(), count, 120);
+        cv::Mat canvas = frame.clone();
+        runCase(options, "drawHeadPoseAxes " + std::to_string(count) + " faces 1920x1080", [&] {
+            for (size_t i = 0; i < faces.size(); i++) {
+                cv::Point3f center(faces[i].x + faces[i].width / 2, faces[i].y + faces[i].height / 2, 0);
+                drawHeadPoseAxes(canvas, center, 10.0 * i, -5.0, 3.0, 50, cameraMatrix);
+            }
+            sink += canvas.data[0];
+        });
+    }
+    return 0;
+}
@@ -0,0 +1,118 @@
+/*
+// Copyright (c) 2018 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma once
+
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include <cstddef>
+
+/**
+* \brief Fixed capacity FIFO shared between one or more producers and a consumer thread.
+* tryPush() never blocks, so the inference loop can hand work to a background thread
+* and simply count what did not fit.
+*/
+template <typename T>
+class BoundedQueue {
+public:
+    explicit BoundedQueue(size_t capacity) : _capacity(capacity ? capacity : 1) {}
+
+    /** Returns false (and drops the item) when the queue is full or closed **/
+    bool tryPush(T item) {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            if (_closed || _items.size() >= _capacity) {
+                return false;
+            }
+            _items.push_back(std::move(item));
+        }
+        _notEmpty.notify_one();
+        return true;
+    }
+
+    /** Blocks while the queue is full, returns false if it was closed meanwhile **/
+    bool push(T item) {
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _notFull.wait(lock, [this] { return _closed || _items.size() < _capacity; });
+            if (_closed) {
+                return false;
+            }
+            _items.push_back(std::move(item));
+        }
+        _notEmpty.notify_one();
+        return true;
+    }
+
+    /** Blocks until an item is available, returns false once closed and drained **/
+    bool pop(T &item) {
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _notEmpty.wait(lock, [this] { return _closed || !_items.empty(); });
+            if (_items.empty()) {
+                return false;
+            }
+            item = std::move(_items.front());
+            _items.pop_front();
+        }
+        _notFull.notify_one();
+        return true;
+    }
+
+    /** Blocks until at least one item is available, then moves out everything queued **/
+    bool popAll(std::deque<T> &items) {
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _notEmpty.wait(lock, [this] { return _closed || !_items.empty(); });
+            if (_items.empty()) {
+                return false;
+            }
+            items.clear();
+            items.swap(_items);
+        }
+        _notFull.notify_all();
+        return true;
+    }
+
+    /** Wakes up all waiters; already queued items can still be popped **/
+    void close() {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _closed = true;
+        }
+        _notEmpty.notify_all();
+        _notFull.notify_all();
+    }
+
+    size_t size() const {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return _items.size();
+    }
+
+    size_t capacity() const {
+        return _capacity;
+    }
+
+private:
+    const size_t _capacity;
+    bool _closed = false;
+    std::deque<T> _items;
+    mutable std::mutex _mutex;
+    std::condition_variable _notEmpty;
+    std::condition_variable _notFull;
+};
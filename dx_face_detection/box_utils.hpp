@@ -0,0 +1,112 @@
+/*
+// Copyright (c) 2018 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma once
+
+#include <vector>
+#include <utility>
+#include <numeric>
+#include <algorithm>
+#include <cmath>
+
+#include <opencv2/opencv.hpp>
+
+/** Intersection over union of two boxes, 0 when either is empty **/
+inline float intersectionOverUnion(const cv::Rect &a, const cv::Rect &b) {
+    const float intersection = static_cast<float>((a & b).area());
+    const float unionArea = static_cast<float>(a.area() + b.area()) - intersection;
+    return unionArea > 0 ? intersection / unionArea : 0.f;
+}
+
+/**
+* \brief Greedy non-maximum suppression: keeps the most confident box of every group of boxes
+* overlapping by more than iouThreshold. Returns the indices of the kept boxes, most confident first.
+*/
+inline std::vector<size_t> nonMaximumSuppression(const std::vector<cv::Rect> &boxes, const std::vector<float> &scores,
+                                                 float iouThreshold) {
+    std::vector<size_t> order(boxes.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) { return scores[a] > scores[b]; });
+
+    std::vector<size_t> kept;
+    std::vector<bool> suppressed(boxes.size(), false);
+    for (size_t i = 0; i < order.size(); i++) {
+        if (suppressed[order[i]]) {
+            continue;
+        }
+        kept.push_back(order[i]);
+        for (size_t j = i + 1; j < order.size(); j++) {
+            if (!suppressed[order[j]] && intersectionOverUnion(boxes[order[i]], boxes[order[j]]) > iouThreshold) {
+                suppressed[order[j]] = true;
+            }
+        }
+    }
+    return kept;
+}
+
+/**
+* \brief Pairs boxes of a with boxes of b, greedily by the highest IoU first.
+* Only pairs overlapping by at least minIou are matched. Returns (index in a, index in b) pairs.
+*/
+inline std::vector<std::pair<size_t, size_t>> matchBoxes(const std::vector<cv::Rect> &a, const std::vector<cv::Rect> &b,
+                                                         float minIou) {
+    std::vector<std::pair<float, std::pair<size_t, size_t>>> candidates;
+    for (size_t i = 0; i < a.size(); i++) {
+        for (size_t j = 0; j < b.size(); j++) {
+            const float iou = intersectionOverUnion(a[i], b[j]);
+            if (iou >= minIou) {
+                candidates.push_back(std::make_pair(iou, std::make_pair(i, j)));
+            }
+        }
+    }
+    std::stable_sort(candidates.begin(), candidates.end(),
+                     [](const std::pair<float, std::pair<size_t, size_t>> &x,
+                        const std::pair<float, std::pair<size_t, size_t>> &y) { return x.first > y.first; });
+
+    std::vector<bool> usedA(a.size(), false), usedB(b.size(), false);
+    std::vector<std::pair<size_t, size_t>> matches;
+    for (auto &&candidate : candidates) {
+        const size_t i = candidate.second.first, j = candidate.second.second;
+        if (!usedA[i] && !usedB[j]) {
+            usedA[i] = usedB[j] = true;
+            matches.push_back(candidate.second);
+        }
+    }
+    return matches;
+}
+
+/**
+* \brief Splits a frame into cols x rows tiles of equal size that overlap their neighbours by the given
+* fraction of the tile size. Tiles are listed row by row and the last ones end at the frame border.
+*/
+inline std::vector<cv::Rect> tileGrid(const cv::Size &frame, int cols, int rows, double overlap) {
+    auto tileLength = [overlap](int length, int count) {
+        return static_cast<int>(std::ceil(length / (count - (count - 1) * overlap)));
+    };
+    const int tileWidth = std::min(frame.width, tileLength(frame.width, cols));
+    const int tileHeight = std::min(frame.height, tileLength(frame.height, rows));
+
+    std::vector<cv::Rect> tiles;
+    for (int r = 0; r < rows; r++) {
+        for (int c = 0; c < cols; c++) {
+            const int x = cols > 1 ? (frame.width - tileWidth) * c / (cols - 1) : 0;
+            const int y = rows > 1 ? (frame.height - tileHeight) * r / (rows - 1) : 0;
+            tiles.push_back(cv::Rect(x, y, tileWidth, tileHeight));
+        }
+    }
+    return tiles;
+}
@@ -0,0 +1,173 @@
+/*
+// Copyright (c) 2018 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma once
+
+#include <string>
+#include <vector>
+#include <chrono>
+#include <thread>
+#include <iomanip>
+#include <algorithm>
+#include <cstdint>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#include <sys/resource.h>
+#endif
+
+#include <samples/slog.hpp>
+
+#ifdef _WIN32
+inline double fileTimeMs(const FILETIME &time) {
+    return ((static_cast<uint64_t>(time.dwHighDateTime) << 32) | time.dwLowDateTime) / 1e4;
+}
+#endif
+
+/** CPU time the calling thread used so far in milliseconds **/
+inline double threadCpuMs() {
+#ifdef _WIN32
+    FILETIME creation, exit, kernel, user;
+    GetThreadTimes(GetCurrentThread(), &creation, &exit, &kernel, &user);
+    return fileTimeMs(kernel) + fileTimeMs(user);
+#else
+    timespec time;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &time);
+    return time.tv_sec * 1e3 + time.tv_nsec / 1e6;
+#endif
+}
+
+/** User and system CPU time of all threads of the process in milliseconds, including the plugin thread pools **/
+inline double processCpuMs() {
+#ifdef _WIN32
+    FILETIME creation, exit, kernel, user;
+    GetProcessTimes(GetCurrentProcess(), &creation, &exit, &kernel, &user);
+    return fileTimeMs(kernel) + fileTimeMs(user);
+#else
+    rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return (usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1e3 +
+           (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e3;
+#endif
+}
+
+/**
+* \brief CPU cost of the processing loop. lap() charges the CPU and wall time the calling thread spent since
+* the previous lap to a stage, the process CPU time between start() and stop() also covers the threads of
+* the plugins, the batcher and the writers. Plugins whose worker threads spin while they wait for work are
+* counted as busy, as they are for the host that runs them.
+*/
+class CpuAccounting {
+public:
+    void start() {
+        _processStartMs = processCpuMs();
+        _wallStart = std::chrono::high_resolution_clock::now();
+        _lapCpuMs = threadCpuMs();
+        _lapWall = _wallStart;
+        _stopped = false;
+    }
+
+    void lap(const char *stage) {
+        const double cpuMs = threadCpuMs();
+        const auto wall = std::chrono::high_resolution_clock::now();
+        Stage *charged = nullptr;
+        for (auto &&existing : _stages) {
+            if (existing.name == stage) {
+                charged = &existing;
+                break;
+            }
+        }
+        if (!charged) {
+            _stages.push_back(Stage{stage, 0, 0});
+            charged = &_stages.back();
+        }
+        charged->cpuMs += cpuMs - _lapCpuMs;
+        charged->wallMs += std::chrono::duration_cast<ms>(wall - _lapWall).count();
+        _lapCpuMs = cpuMs;
+        _lapWall = wall;
+    }
+
+    /** Ends the process totals, only the first call after start() counts **/
+    void stop() {
+        if (_stopped) {
+            return;
+        }
+        _processMs = processCpuMs() - _processStartMs;
+        _wallMs = std::chrono::duration_cast<ms>(std::chrono::high_resolution_clock::now() - _wallStart).count();
+        _stopped = true;
+    }
+
+    /**
+    * \brief Prints CPU milliseconds per frame by stage and for the process, the cores kept busy and how many
+    * streams of streamFps processed frames per second the cores of this host could sustain (skipped for 0)
+    */
+    void print(size_t frames, double streamFps) const {
+        if (frames == 0 || _wallMs <= 0) {
+            return;
+        }
+        slog::info << "   CPU time per frame:" << slog::endl;
+        double threadMs = 0;
+        for (auto &&stage : _stages) {
+            slog::info << "     " << std::left << std::setw(14) << stage.name << std::right << ": " << std::fixed
+                       << std::setprecision(2) << stage.cpuMs / frames << " ms CPU, " << stage.wallMs / frames
+                       << " ms wall (" << std::setprecision(0) << percent(stage.cpuMs, stage.wallMs) << "% of a core)"
+                       << slog::endl;
+            threadMs += stage.cpuMs;
+        }
+        const size_t cores = std::max(1u, std::thread::hardware_concurrency());
+        const double msPerFrame = _processMs / frames;
+        if (!_stages.empty()) {
+            slog::info << "     Main thread   : " << std::setprecision(2) << threadMs / frames << " ms" << slog::endl;
+            slog::info << "     Other threads : " << (_processMs - threadMs) / frames
+                       << " ms (plugin thread pools, second stage batcher, writers)" << slog::endl;
+        }
+        slog::info << "     Process       : " << std::setprecision(2) << msPerFrame << " ms CPU per frame, "
+                   << _processMs / _wallMs << " of " << cores << " cores busy" << slog::endl;
+        if (streamFps > 0 && msPerFrame > 0) {
+            // a stream needs msPerFrame of CPU for every one of its streamFps frames per second
+            const double coresPerStream = msPerFrame * streamFps / 1000;
+            slog::info << "   Sustainable streams per host at " << std::setprecision(1) << streamFps
+                       << " processed fps: " << std::setprecision(1) << cores / coresPerStream << " ("
+                       << std::setprecision(2) << coresPerStream << " cores per stream)" << slog::endl;
+        }
+    }
+
+private:
+    typedef std::chrono::duration<double, std::ratio<1, 1000>> ms;
+
+    struct Stage {
+        std::string name;
+        double cpuMs;
+        double wallMs;
+    };
+
+    static double percent(double part, double whole) {
+        return whole > 0 ? 100.0 * part / whole : 0.0;
+    }
+
+    std::vector<Stage> _stages;
+    double _lapCpuMs = 0;
+    std::chrono::high_resolution_clock::time_point _lapWall;
+
+    double _processStartMs = 0;
+    std::chrono::high_resolution_clock::time_point _wallStart;
+    double _processMs = 0;
+    double _wallMs = 0;
+    bool _stopped = true;
+};
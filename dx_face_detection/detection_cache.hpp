@@ -0,0 +1,386 @@
+/*
+// Copyright (c) 2018 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma once
+
+/**
+* \brief File with the face detections of a video, replayed into the second stage without decoding the
+* video or running Face Detection again.
+*
+* The file starts with a DetectionCacheHeader. With crops, the face crops follow it back to back, each
+* cropWidth x cropHeight BGR pixels resized from the detected box. The frame table (frameCount entries)
+* and the face table (faceCount entries) start at framesOffset and facesOffset, the faces of a frame are
+* consecutive. The first crop and both tables start at multiples of 64 bytes, so a mapped file is used in place.
+* complete is set once the tables are written, a file without it is recorded again.
+*/
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <fstream>
+#include <stdexcept>
+#include <cstring>
+#include <cerrno>
+#include <cstdint>
+#include <algorithm>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+#include <opencv2/opencv.hpp>
+#include <samples/slog.hpp>
+
+#include "detection_utils.hpp"
+
+static const uint32_t detectionCacheMagic = 0x43434446;  // "FDCC"
+static const uint32_t detectionCacheVersion = 1;
+
+struct DetectionCacheHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t key;               // see detectionCacheKey, a cache of other inputs is recorded again
+    uint64_t frameCount;
+    uint64_t faceCount;
+    uint64_t framesOffset;
+    uint64_t facesOffset;
+    uint32_t cropWidth;         // 0 without crops
+    uint32_t cropHeight;
+    uint32_t complete;
+    uint32_t reserved;
+};
+
+struct DetectionCacheFrame {
+    int64_t frameIndex;
+    double timestampMs;
+    uint32_t width;
+    uint32_t height;
+    uint64_t firstFace;
+    uint32_t faceCount;
+    uint32_t reserved;
+};
+
+struct DetectionCacheFace {
+    int32_t x;
+    int32_t y;
+    int32_t width;
+    int32_t height;
+    float confidence;
+    int32_t label;
+    uint64_t cropOffset;        // 0 without crops
+};
+
+namespace DetectionCacheLayout {
+
+static const size_t alignment = 64;
+
+inline uint64_t alignUp(uint64_t value) {
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+}  // namespace DetectionCacheLayout
+
+/** FNV-1a over bytes, chained through hash **/
+inline uint64_t hashBytes(const void *data, size_t size, uint64_t hash = 14695981039346656037ull) {
+    const unsigned char *bytes = static_cast<const unsigned char *>(data);
+    for (size_t i = 0; i < size; i++) {
+        hash = (hash ^ bytes[i]) * 1099511628211ull;
+    }
+    return hash;
+}
+
+/**
+* \brief Key of the detections of a source: the contents of the model files, the size and modification
+* time of the source file (hashing a long video would cost as much as decoding it) and the settings that
+* change the detections, such as the threshold, tiles, stride and stub parameters.
+*/
+inline uint64_t detectionCacheKey(const std::string &sourcePath, const std::vector<std::string> &modelFiles,
+                                  const std::string &settings) {
+    uint64_t hash = hashBytes(settings.data(), settings.size());
+    for (auto &&path : modelFiles) {
+        hash = hashBytes(path.data(), path.size(), hash);
+        std::ifstream file(path, std::ios::binary);
+        std::vector<char> chunk(1 << 16);
+        while (file.read(chunk.data(), chunk.size()) || file.gcount() > 0) {
+            hash = hashBytes(chunk.data(), static_cast<size_t>(file.gcount()), hash);
+        }
+    }
+    hash = hashBytes(sourcePath.data(), sourcePath.size(), hash);
+#ifndef _WIN32
+    struct stat st;
+    if (stat(sourcePath.c_str(), &st) == 0) {
+        const int64_t stamp[2] = {static_cast<int64_t>(st.st_size), static_cast<int64_t>(st.st_mtime)};
+        hash = hashBytes(stamp, sizeof(stamp), hash);
+    }
+#endif
+    return hash;
+}
+
+/**
+* \brief Records the detections of the processed frames, see the layout above. Crops are only stored
+* with a non-empty cropSize. The tables are written by close(), only close(true) at the end of the video
+* marks the cache complete. A writer destroyed without close(), e.g. after an exception, leaves it incomplete.
+*/
+class DetectionCacheWriter {
+public:
+    DetectionCacheWriter(const std::string &path, uint64_t key, const cv::Size &cropSize)
+        : _path(path), _file(path, std::ios::binary | std::ios::trunc), _cropSize(cropSize) {
+        if (!_file) {
+            throw std::logic_error("Cannot create detection cache " + path);
+        }
+        std::memset(&_header, 0, sizeof(_header));
+        _header.magic = detectionCacheMagic;
+        _header.version = detectionCacheVersion;
+        _header.key = key;
+        _header.cropWidth = static_cast<uint32_t>(std::max(0, cropSize.width));
+        _header.cropHeight = static_cast<uint32_t>(std::max(0, cropSize.height));
+        writeAt(0, &_header, sizeof(_header));
+        _offset = DetectionCacheLayout::alignUp(sizeof(_header));
+    }
+
+    ~DetectionCacheWriter() {
+        if (!_closed) {
+            try {
+                close(false);
+            } catch (const std::exception &error) {
+                slog::err << error.what() << slog::endl;
+            }
+        }
+    }
+
+    void add(int64_t frameIndex, double timestampMs, const cv::Mat &frame, const std::vector<DetectionResult> &results) {
+        DetectionCacheFrame entry;
+        std::memset(&entry, 0, sizeof(entry));
+        entry.frameIndex = frameIndex;
+        entry.timestampMs = timestampMs;
+        entry.width = static_cast<uint32_t>(frame.cols);
+        entry.height = static_cast<uint32_t>(frame.rows);
+        entry.firstFace = _faces.size();
+        entry.faceCount = static_cast<uint32_t>(results.size());
+        _frames.push_back(entry);
+
+        for (auto &&result : results) {
+            DetectionCacheFace face;
+            std::memset(&face, 0, sizeof(face));
+            face.x = result.location.x;
+            face.y = result.location.y;
+            face.width = result.location.width;
+            face.height = result.location.height;
+            face.confidence = result.confidence;
+            face.label = result.label;
+            if (_header.cropWidth > 0) {
+                const cv::Mat crop = cropFace(frame, result.location);
+                if (crop.empty()) {
+                    _crop = cv::Mat(_cropSize, CV_8UC3, cv::Scalar::all(0));
+                } else {
+                    cv::resize(crop, _crop, _cropSize);
+                }
+                const size_t bytes = _crop.total() * _crop.elemSize();
+                face.cropOffset = _offset;
+                writeAt(_offset, _crop.data, bytes);
+                _offset += bytes;
+            }
+            _faces.push_back(face);
+        }
+    }
+
+    void close(bool complete) {
+        _closed = true;
+        _header.framesOffset = DetectionCacheLayout::alignUp(_offset);
+        _header.frameCount = _frames.size();
+        writeAt(_header.framesOffset, _frames.data(), _frames.size() * sizeof(DetectionCacheFrame));
+        _header.facesOffset = DetectionCacheLayout::alignUp(_header.framesOffset + _frames.size() * sizeof(DetectionCacheFrame));
+        _header.faceCount = _faces.size();
+        writeAt(_header.facesOffset, _faces.data(), _faces.size() * sizeof(DetectionCacheFace));
+        _header.complete = complete ? 1 : 0;
+        writeAt(0, &_header, sizeof(_header));
+        _file.close();
+        if (!_file) {
+            throw std::logic_error("Cannot write detection cache " + _path);
+        }
+    }
+
+    void printStatistics() const {
+        slog::info << "   Detection cache " << _path << ": " << _frames.size() << " frames, " << _faces.size()
+                   << " faces" << (_header.cropWidth > 0 ? " with " + std::to_string(_header.cropWidth) + "x" +
+                                   std::to_string(_header.cropHeight) + " crops" : std::string()) << ", "
+                   << (_header.facesOffset + _faces.size() * sizeof(DetectionCacheFace)) / 1024 << " KB" << slog::endl;
+    }
+
+private:
+    void writeAt(uint64_t offset, const void *data, size_t size) {
+        _file.seekp(static_cast<std::streamoff>(offset));
+        _file.write(static_cast<const char *>(data), size);
+        if (!_file) {
+            throw std::logic_error("Cannot write detection cache " + _path);
+        }
+    }
+
+    const std::string _path;
+    std::ofstream _file;
+    const cv::Size _cropSize;
+    DetectionCacheHeader _header;
+    uint64_t _offset = 0;
+    std::vector<DetectionCacheFrame> _frames;
+    std::vector<DetectionCacheFace> _faces;
+    cv::Mat _crop;
+    bool _closed = false;
+};
+
+/**
+* \brief A complete detection cache, mapped read-only where mmap is available and read into memory
+* elsewhere. Crops are wrapped in place and stay valid as long as the cache.
+*/
+class DetectionCache {
+public:
+    /** nullptr when there is no cache at path, or one of other inputs or one that was not completed **/
+    static std::unique_ptr<DetectionCache> open(const std::string &path, uint64_t key) {
+        std::unique_ptr<DetectionCache> cache(new DetectionCache());
+        if (!cache->load(path)) {
+            return nullptr;
+        }
+        const DetectionCacheHeader &header = cache->header();
+        if (header.magic != detectionCacheMagic || header.version != detectionCacheVersion) {
+            slog::warn << path << " is not a detection cache of version " << detectionCacheVersion
+                       << ", recording it again" << slog::endl;
+            return nullptr;
+        }
+        if (header.key != key) {
+            slog::warn << "Detection cache " << path << " was recorded from another source, model or settings, "
+                       << "recording it again" << slog::endl;
+            return nullptr;
+        }
+        if (!header.complete) {
+            slog::warn << "Detection cache " << path << " is incomplete, recording it again" << slog::endl;
+            return nullptr;
+        }
+        const uint64_t cropBytes = static_cast<uint64_t>(header.cropWidth) * header.cropHeight * 3;
+        const uint64_t size = cache->_size;
+        if (header.frameCount > size / sizeof(DetectionCacheFrame) || header.faceCount > size / sizeof(DetectionCacheFace) ||
+            header.framesOffset > size - header.frameCount * sizeof(DetectionCacheFrame) ||
+            header.facesOffset > size - header.faceCount * sizeof(DetectionCacheFace)) {
+            throw std::logic_error("Detection cache " + path + " is truncated");
+        }
+        for (uint64_t i = 0; i < header.frameCount; i++) {
+            const DetectionCacheFrame &frame = cache->frame(i);
+            if (frame.firstFace > header.faceCount || frame.faceCount > header.faceCount - frame.firstFace) {
+                throw std::logic_error("Detection cache " + path + " is truncated");
+            }
+        }
+        for (uint64_t i = 0; i < header.faceCount; i++) {
+            const DetectionCacheFace &face = cache->face(i);
+            if (cropBytes > 0 && (face.cropOffset == 0 || cropBytes > size || face.cropOffset > size - cropBytes)) {
+                throw std::logic_error("Detection cache " + path + " has a crop outside of the file");
+            }
+        }
+        return cache;
+    }
+
+    ~DetectionCache() {
+#ifndef _WIN32
+        if (_mapped) {
+            munmap(_mapped, _size);
+        }
+#endif
+    }
+
+    const DetectionCacheHeader &header() const {
+        return *reinterpret_cast<const DetectionCacheHeader *>(_data);
+    }
+
+    size_t frameCount() const {
+        return header().frameCount;
+    }
+
+    const DetectionCacheFrame &frame(size_t i) const {
+        return reinterpret_cast<const DetectionCacheFrame *>(_data + header().framesOffset)[i];
+    }
+
+    const DetectionCacheFace &face(size_t i) const {
+        return reinterpret_cast<const DetectionCacheFace *>(_data + header().facesOffset)[i];
+    }
+
+    bool hasCrops() const {
+        return header().cropWidth > 0;
+    }
+
+    /** Read-only view of the stored crop of a face **/
+    cv::Mat crop(const DetectionCacheFace &face) const {
+        return cv::Mat(static_cast<int>(header().cropHeight), static_cast<int>(header().cropWidth), CV_8UC3,
+                       const_cast<char *>(_data + face.cropOffset));
+    }
+
+    static DetectionResult result(const DetectionCacheFace &face) {
+        DetectionResult result;
+        result.label = face.label;
+        result.confidence = face.confidence;
+        result.location = cv::Rect(face.x, face.y, face.width, face.height);
+        result.batchIndex = 0;
+        return result;
+    }
+
+    size_t sizeBytes() const {
+        return _size;
+    }
+
+private:
+    DetectionCache() {}
+
+    bool load(const std::string &path) {
+#ifndef _WIN32
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            return false;
+        }
+        struct stat st;
+        if (fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(DetectionCacheHeader)) {
+            ::close(fd);
+            return false;
+        }
+        _size = st.st_size;
+        void *mapped = mmap(nullptr, _size, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if (mapped == MAP_FAILED) {
+            throw std::logic_error("Cannot map detection cache " + path + ": " + std::strerror(errno));
+        }
+        _mapped = mapped;
+        _data = static_cast<const char *>(mapped);
+#else
+        std::ifstream file(path, std::ios::binary | std::ios::ate);
+        if (!file || static_cast<size_t>(file.tellg()) < sizeof(DetectionCacheHeader)) {
+            return false;
+        }
+        _size = static_cast<size_t>(file.tellg());
+        _contents.resize(_size);
+        file.seekg(0);
+        file.read(_contents.data(), _size);
+        _data = _contents.data();
+#endif
+        return true;
+    }
+
+    const char *_data = nullptr;
+    size_t _size = 0;
+#ifndef _WIN32
+    void *_mapped = nullptr;
+#else
+    std::vector<char> _contents;
+#endif
+};
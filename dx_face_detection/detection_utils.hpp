@@ -0,0 +1,159 @@
+/*
+// Copyright (c) 2018 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma once
+
+/**
+* \brief Per-frame CPU work around the networks, free of command line flags and infer requests
+* so it can be used by the detectors and measured on its own (see benchmark/).
+*/
+
+#include <vector>
+#include <ostream>
+#include <cmath>
+
+#include <opencv2/opencv.hpp>
+
+/// @brief One face found by the detector, location in pixels of the frame it was found in
+struct DetectionResult {
+    int label;
+    float confidence;
+    cv::Rect location;
+    int batchIndex;
+};
+
+/**
+* \brief Parses a DetectionOutput blob of [maxProposalCount x objectSize] values.
+* Only detections of the frameSizes.size() submitted frames with a confidence above threshold are kept,
+* their normalized coordinates are scaled to the size of their frame. Writes the -r lines to raw if given.
+*/
+inline void parseDetectionOutput(const float *detections, int maxProposalCount, int objectSize, int batchSize,
+                                 const std::vector<cv::Size> &frameSizes, float threshold,
+                                 std::vector<DetectionResult> &results, std::ostream *raw = nullptr) {
+    for (int i = 0; i < maxProposalCount; i++) {
+        float image_id = detections[i * objectSize + 0];
+        if ((image_id < 0) || (image_id >= batchSize)) {  // indicates end of detections
+            break;
+        }
+        DetectionResult r;
+        r.batchIndex = static_cast<int>(image_id);
+        if (r.batchIndex >= static_cast<int>(frameSizes.size())) {  // stale slot of a partially filled batch
+            continue;
+        }
+        r.label = static_cast<int>(detections[i * objectSize + 1]);
+        r.confidence = detections[i * objectSize + 2];
+        if (r.confidence <= threshold) {
+            continue;
+        }
+
+        const float frameWidth = frameSizes[r.batchIndex].width;
+        const float frameHeight = frameSizes[r.batchIndex].height;
+        r.location.x = detections[i * objectSize + 3] * frameWidth;
+        r.location.y = detections[i * objectSize + 4] * frameHeight;
+        r.location.width = detections[i * objectSize + 5] * frameWidth - r.location.x;
+        r.location.height = detections[i * objectSize + 6] * frameHeight - r.location.y;
+        if (raw) {
+            *raw << "[" << i << "," << r.label << "] element, prob = " << r.confidence <<
+                    "    (" << r.location.x << "," << r.location.y << ")-(" << r.location.width << ","
+                    << r.location.height << ")"
+                    << ((r.confidence > threshold) ? " WILL BE RENDERED!" : "") << '\n';
+        }
+
+        results.push_back(r);
+    }
+}
+
+/** The part of a detected face that lies inside the frame, without copying pixels **/
+inline cv::Mat cropFace(const cv::Mat &frame, const cv::Rect &location) {
+    return frame(location & cv::Rect(0, 0, frame.cols, frame.rows));
+}
+
+inline cv::Mat makeCameraMatrix(int cx, int cy, float focalLength) {
+    cv::Mat cameraMatrix = cv::Mat::zeros(3, 3, CV_32F);
+    cameraMatrix.at<float>(0) = focalLength;
+    cameraMatrix.at<float>(2) = static_cast<float>(cx);
+    cameraMatrix.at<float>(4) = focalLength;
+    cameraMatrix.at<float>(5) = static_cast<float>(cy);
+    cameraMatrix.at<float>(8) = 1;
+    return cameraMatrix;
+}
+
+/** Draws the head pose axes, angles in degrees, centered at cpoint **/
+inline void drawHeadPoseAxes(cv::Mat& frame, cv::Point3f cpoint, double yaw, double pitch, double roll, float scale,
+                             const cv::Mat &cameraMatrix) {
+    pitch *= CV_PI / 180.0;
+    yaw   *= CV_PI / 180.0;
+    roll  *= CV_PI / 180.0;
+
+    cv::Matx33f        Rx(1,           0,            0,
+                          0,  cos(pitch),  -sin(pitch),
+                          0,  sin(pitch),  cos(pitch));
+    cv::Matx33f Ry(cos(yaw),           0,    -sin(yaw),
+                          0,           1,            0,
+                   sin(yaw),           0,    cos(yaw));
+    cv::Matx33f Rz(cos(roll), -sin(roll),            0,
+                   sin(roll),  cos(roll),            0,
+                          0,           0,            1);
+
+
+    auto r = cv::Mat(Rz*Ry*Rx);
+
+    cv::Mat xAxis(3, 1, CV_32F), yAxis(3, 1, CV_32F), zAxis(3, 1, CV_32F), zAxis1(3, 1, CV_32F);
+
+    xAxis.at<float>(0) = 1 * scale;
+    xAxis.at<float>(1) = 0;
+    xAxis.at<float>(2) = 0;
+
+    yAxis.at<float>(0) = 0;
+    yAxis.at<float>(1) = -1 * scale;
+    yAxis.at<float>(2) = 0;
+
+    zAxis.at<float>(0) = 0;
+    zAxis.at<float>(1) = 0;
+    zAxis.at<float>(2) = -1 * scale;
+
+    zAxis1.at<float>(0) = 0;
+    zAxis1.at<float>(1) = 0;
+    zAxis1.at<float>(2) = 1 * scale;
+
+    cv::Mat o(3, 1, CV_32F, cv::Scalar(0));
+    o.at<float>(2) = cameraMatrix.at<float>(0);
+
+    xAxis = r * xAxis + o;
+    yAxis = r * yAxis + o;
+    zAxis = r * zAxis + o;
+    zAxis1 = r * zAxis1 + o;
+
+    cv::Point p1, p2;
+
+    p2.x = static_cast<int>((xAxis.at<float>(0) / xAxis.at<float>(2) * cameraMatrix.at<float>(0)) + cpoint.x);
+    p2.y = static_cast<int>((xAxis.at<float>(1) / xAxis.at<float>(2) * cameraMatrix.at<float>(4)) + cpoint.y);
+    cv::line(frame, cv::Point(cpoint.x, cpoint.y), p2, cv::Scalar(0, 0, 255), 2);
+
+    p2.x = static_cast<int>((yAxis.at<float>(0) / yAxis.at<float>(2) * cameraMatrix.at<float>(0)) + cpoint.x);
+    p2.y = static_cast<int>((yAxis.at<float>(1) / yAxis.at<float>(2) * cameraMatrix.at<float>(4)) + cpoint.y);
+    cv::line(frame, cv::Point(cpoint.x, cpoint.y), p2, cv::Scalar(0, 255, 0), 2);
+
+    p1.x = static_cast<int>((zAxis1.at<float>(0) / zAxis1.at<float>(2) * cameraMatrix.at<float>(0)) + cpoint.x);
+    p1.y = static_cast<int>((zAxis1.at<float>(1) / zAxis1.at<float>(2) * cameraMatrix.at<float>(4)) + cpoint.y);
+
+    p2.x = static_cast<int>((zAxis.at<float>(0) / zAxis.at<float>(2) * cameraMatrix.at<float>(0)) + cpoint.x);
+    p2.y = static_cast<int>((zAxis.at<float>(1) / zAxis.at<float>(2) * cameraMatrix.at<float>(4)) + cpoint.y);
+    cv::line(frame, p1, p2, cv::Scalar(255, 0, 0), 2);
+
+    cv::circle(frame, p2, 3, cv::Scalar(255, 0, 0), 2);
+}
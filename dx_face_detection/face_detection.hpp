@@ -32,12 +32,25 @@
 static const char help_message[] = "Print a usage message.";
 
 /// @brief message for images argument
-static const char video_message[] = "Optional. Path to an video file. Default value is \"cam\" to work with camera.";
+static const char video_message[] = "Optional. Path to an video file or to a directory of images, or \"shm:<name>\" to read " \
+"frames from a shared memory ring. Default value is \"cam\" to work with camera.";
+
+/// @brief message for shared memory input timeout
+static const char shm_timeout_message[] = "Optional. Milliseconds to wait for a new frame from shared memory before stopping ( default is 5000).";
 
 /// @brief message for model argument
 static const char face_detection_model_message[] = "Required. Path to an .xml file with a trained face detection model.";
 static const char age_gender_model_message[] = "Optional. Path to an .xml file with a trained age gender model.";
 static const char head_pose_model_message[] = "Optional. Path to an .xml file with a trained head pose model.";
+static const char attribute_models_message[] = "Optional. Additional per-face networks as \"<name>,<path to .xml>[,<device>[,<batch>]]\" " \
+"separated by ';'. All outputs of these networks are reported per face under <name>.";
+
+/// @brief message for precision comparison arguments
+static const char ab_model_message[] = "Optional. Variant B of the face detection model (e.g. FP16 or INT8) to compare with -m. " \
+"Any -ab_m* parameter runs the precision comparison instead of the normal output.";
+static const char ab_age_gender_model_message[] = "Optional. Variant B of the age gender model to compare with -m_ag.";
+static const char ab_head_pose_model_message[] = "Optional. Variant B of the head pose model to compare with -m_hp.";
+static const char ab_frames_message[] = "Optional. Number of frames compared by the precision comparison ( default is 0, all frames).";
 
 /// @brief message for plugin argument
 static const char plugin_message[] = "Plugin name. For example MKLDNNPlugin. If this parameter is pointed, " \
@@ -47,6 +60,95 @@ static const char plugin_message[] = "Plugin name. For example MKLDNNPlugin. If
 static const char target_device_message[] = "Specify the target device for Face Detection (CPU, GPU, FPGA, or MYRIAD. " \
 "Sample will look for a suitable plugin for device specified.";
 
+/// @brief message for inference backend argument
+static const char backend_message[] = "Optional. Inference backend: ie runs the models on the Inference Engine plugins, stub makes up " \
+"detections and attributes after simulated latencies, for load tests without models ( default is ie).";
+
+/// @brief message for stub backend latencies
+static const char stub_latency_message[] = "Optional. Latencies of the stub backend as \"<network>=<distribution>:<a>[,<b>][+<ms per item>]\" " \
+"separated by ';', network is fd, ag, hp or a -m_attr name, distribution is fixed, uniform, normal or lognormal.";
+
+/// @brief message for stub backend faces per frame
+static const char stub_faces_message[] = "Optional. Mean number of faces per frame detected by the stub backend ( default is 2).";
+
+/// @brief message for stub backend seed
+static const char stub_seed_message[] = "Optional. Seed of the stub backend, runs with the same seed get the same latencies and results ( default is 1).";
+
+/// @brief message for face detection input reshape
+static const char fd_reshape_message[] = "Optional. Reshape the Face Detection input before loading, either to \"<width>x<height>\" " \
+"or to a number of pixels at the aspect ratio of the input stream. Default is the input size of the IR.";
+
+/// @brief message for tiled face detection
+static const char fd_tiles_message[] = "Optional. Run Face Detection on \"<columns>x<rows>\" overlapping tiles of each video frame, " \
+"so small faces of high resolution streams are not lost when the frame is scaled down.";
+
+/// @brief message for the overlap of face detection tiles
+static const char fd_tile_overlap_message[] = "Optional. Overlap of neighbouring tiles as a fraction of the tile size ( default is 0.2).";
+
+/// @brief message for the whole frame tile
+static const char fd_tile_full_message[] = "Optional. Also run Face Detection on the whole frame, for faces larger than the tile overlap.";
+
+/// @brief message for merging the detections of neighbouring tiles
+static const char fd_tile_nms_message[] = "Optional. IoU above which detections of neighbouring tiles are merged into one face ( default is 0.4).";
+
+/// @brief message for concurrent tile requests
+static const char fd_tile_async_message[] = "Optional. Run every tile in its own concurrent infer request instead of one batch.";
+
+/// @brief message for number of images batched through face detection
+static const char num_batch_fd_message[] = "Specify number of images processed at once by Face Detection when -i is a directory ( default is 1).";
+
+/// @brief message for speculative second stage
+static const char spec_message[] = "Optional. Start the second stage networks on the faces of the previous frame, moved to where they " \
+"are expected, while Face Detection still runs on the frame. Only faces the prediction missed are inferred again.";
+
+/// @brief message for speculation overlap threshold
+static const char spec_iou_message[] = "Optional. IoU a detected face needs with a predicted one to keep its speculative attributes ( default is 0.5).";
+
+/// @brief message for U8 input of the second stage networks
+static const char attr_u8_message[] = "Optional. Feed the face crops to the age gender, head pose and -m_attr networks as U8 instead of " \
+"FP32, the plugin converts them while it reads the input.";
+
+/// @brief message for second stage input mean
+static const char attr_mean_message[] = "Optional. Mean subtracted from the input of the age gender, head pose and -m_attr networks by " \
+"the plugin, one value or \"<b>,<g>,<r>\". Only for models without the normalization in their first layer.";
+
+/// @brief message for second stage input scale
+static const char attr_std_message[] = "Optional. Value the plugin divides the mean-subtracted input of the second stage networks by " \
+"( default is 1).";
+
+/// @brief message for the detection cache
+static const char det_cache_message[] = "Optional. File with the face detections of the video file. Detections are recorded into it, " \
+"a later run with the same video, model and detection settings replays them into the second stage without running Face Detection.";
+
+/// @brief message for face crops in the detection cache
+static const char det_cache_crops_message[] = "Optional. Also store the face crops in the detection cache, so replays do not decode the video.";
+
+/// @brief message for micro-batching across frames
+static const char mb_frames_message[] = "Optional. Batch the face crops of consecutive frames for the second stage networks, holding back " \
+"at most this many frames until their results are there ( default is 0, off).";
+
+/// @brief message for micro-batch deadline
+static const char mb_wait_message[] = "Optional. Milliseconds a second stage batch waits for more faces before it runs partially filled ( default is 10).";
+
+/// @brief message for number of image decoder threads
+static const char num_decode_threads_message[] = "Specify number of threads decoding images when -i is a directory ( default is the number of cores).";
+
+/// @brief message for frame stride
+static const char stride_message[] = "Optional. Process every N-th frame of the video; the frames in between are grabbed but not " \
+"retrieved as BGR images ( default is 1, every frame).";
+
+/// @brief message for target processing rate
+static const char target_fps_message[] = "Optional. Process frames at about this rate by choosing the stride from the frame rate " \
+"of the video, overrides -stride ( default is 0, off).";
+
+/// @brief message for segment-parallel processing of video files
+static const char seg_workers_message[] = "Optional. Split a video file into segments processed by this many parallel workers, " \
+"each with its own decoder and infer requests, and merge the results in frame order ( default is 0, off).";
+
+/// @brief message for segment boundary alignment
+static const char seg_gop_message[] = "Optional. Segment boundaries are multiples of this many frames, set it to the keyframe interval " \
+"of the video so segments start on keyframes ( default is 250).";
+
 /// @brief message for assigning age gender calculation to device
 static const char target_device_message_ag[] = "Specify the target device for Age Gender Detection (CPU, GPU, FPGA, or MYRIAD. " \
 "Sample will look for a suitable plugin for device specified.";
@@ -61,8 +163,33 @@ static const char target_device_message_hp[] = "Specify the target device for He
 /// @brief message for number of simultaneously age gender detections using dynamic batch
 static const char num_batch_hp_message[] = "Specify number of maximum simultaneously processed faces for Head Pose Detection ( default is 1).";
 
+/// @brief message for structured results output argument
+static const char results_output_message[] = "Optional. Path to a file, or \"unix:<path>\" for a Unix domain socket, " \
+"receiving one structured record per frame (timestamp, boxes, confidences, age, gender, head pose).";
+
+/// @brief message for structured results format argument
+static const char results_format_message[] = "Optional. Format of the structured results: jsonl or bin ( default is jsonl).";
+
+/// @brief message for structured results drop argument
+static const char results_drop_message[] = "Optional. Drop and count structured results while the -ro queue is full instead " \
+"of waiting for the consumer, so a slow reader cannot stall the pipeline. By default every record is written.";
+
+/// @brief message for server mode argument
+static const char server_message[] = "Optional. Path of a Unix domain socket to serve face detection, age gender and head pose " \
+"to local clients instead of processing -i.";
+
+/// @brief message for server batching deadline argument
+static const char server_wait_message[] = "Optional. Milliseconds a face may wait for a shared second stage batch to fill in server mode ( default is 5).";
+
 /// @brief message for performance counters
-static const char performance_counter_message[] = "Enables per-layer performance report.";
+static const char performance_counter_message[] = "Enables per-layer performance report, accumulated over all inferences.";
+
+/// @brief message for number of hottest layers in the performance report
+static const char performance_counter_top_message[] = "Optional. Number of layers with the largest total time listed for each network with -pc ( default is 10).";
+
+/// @brief message for performance counters export
+static const char performance_counter_out_message[] = "Optional. Path prefix for <prefix>.csv and <prefix>.json exports of the -pc report, " \
+"two CSV exports can be compared with perf_counters_diff.";
 
 /// @brief message for clDNN custom kernels desc
 static const char custom_cldnn_message[] = "Required for clDNN (GPU)-targeted custom kernels."\
@@ -84,6 +211,16 @@ static const char no_wait_for_keypress_message[] = "No wait for key press in the
 /// @brief message no show processed video
 static const char no_show_processed_video[] = "No show processed video.";
 
+/// @brief message for annotated output argument
+static const char output_message[] = "Optional. Path to an output video file, or a printf-style pattern like " \
+"\"out/frame_%05d.jpg\" for a numbered image sequence (one %d with an optional zero-padded width, %% for a literal %). Annotated frames are encoded on a background thread.";
+
+/// @brief message for output video codec argument
+static const char output_fourcc_message[] = "Optional. FOURCC code of the output video codec (default is MJPG).";
+
+/// @brief message for output queue size argument
+static const char output_queue_message[] = "Optional. Number of frames the output writer may queue before frames are dropped ( default is 16).";
+
 
 /// \brief Define flag for showing help message <br>
 DEFINE_bool(h, false, help_message);
@@ -92,6 +229,10 @@ DEFINE_bool(h, false, help_message);
 /// It is a required parameter
 DEFINE_string(i, "cam", video_message);
 
+/// \brief Define parameter for shared memory input timeout <br>
+/// It is an optional parameter
+DEFINE_uint32(shm_timeout, 5000, shm_timeout_message);
+
 /// \brief Define parameter for face detection  model file <br>
 /// It is a required parameter
 DEFINE_string(m, "", face_detection_model_message);
@@ -104,9 +245,89 @@ DEFINE_string(m_ag, "", age_gender_model_message);
 /// It is a required parameter
 DEFINE_string(m_hp, "", head_pose_model_message);
 
+/// \brief Define parameter for additional per-face network models <br>
+/// It is an optional parameter
+DEFINE_string(m_attr, "", attribute_models_message);
+
+/// \brief Define parameters for the variant B models of the precision comparison <br>
+/// They are optional parameters
+DEFINE_string(ab_m, "", ab_model_message);
+DEFINE_string(ab_m_ag, "", ab_age_gender_model_message);
+DEFINE_string(ab_m_hp, "", ab_head_pose_model_message);
+DEFINE_uint32(ab_frames, 0, ab_frames_message);
+
 /// \brief device the target device for face detection infer on <br>
 DEFINE_string(d, "CPU", target_device_message);
 
+/// \brief inference backend and its stub settings <br>
+DEFINE_string(backend, "ie", backend_message);
+DEFINE_string(stub_latency, "", stub_latency_message);
+DEFINE_double(stub_faces, 2.0, stub_faces_message);
+DEFINE_uint32(stub_seed, 1, stub_seed_message);
+
+/// \brief input reshape of face detection <br>
+DEFINE_string(fd_reshape, "", fd_reshape_message);
+
+/// \brief tile grid of face detection <br>
+DEFINE_string(fd_tiles, "", fd_tiles_message);
+
+/// \brief overlap of face detection tiles <br>
+DEFINE_double(fd_tile_overlap, 0.2, fd_tile_overlap_message);
+
+/// \brief whole frame face detection next to the tiles <br>
+DEFINE_bool(fd_tile_full, false, fd_tile_full_message);
+
+/// \brief IoU threshold for merging detections of neighbouring tiles <br>
+DEFINE_double(fd_tile_nms, 0.4, fd_tile_nms_message);
+
+/// \brief one infer request per tile <br>
+DEFINE_bool(fd_tile_async, false, fd_tile_async_message);
+
+/// \brief speculative second stage on predicted faces <br>
+DEFINE_bool(spec, false, spec_message);
+
+/// \brief overlap that confirms a speculative face <br>
+DEFINE_double(spec_iou, 0.5, spec_iou_message);
+
+/// \brief U8 input for the second stage networks <br>
+DEFINE_bool(attr_u8, false, attr_u8_message);
+
+/// \brief mean subtracted from the second stage input <br>
+DEFINE_string(attr_mean, "", attr_mean_message);
+
+/// \brief divisor of the second stage input <br>
+DEFINE_double(attr_std, 1, attr_std_message);
+
+/// \brief file of recorded face detections <br>
+DEFINE_string(det_cache, "", det_cache_message);
+
+/// \brief face crops in the detection cache <br>
+DEFINE_bool(det_cache_crops, false, det_cache_crops_message);
+
+/// \brief frames held back for second stage micro-batches <br>
+DEFINE_uint32(mb_frames, 0, mb_frames_message);
+
+/// \brief deadline of a second stage micro-batch <br>
+DEFINE_double(mb_wait, 10, mb_wait_message);
+
+/// \brief batch size of face detection for image directories <br>
+DEFINE_uint32(n_fd, 1, num_batch_fd_message);
+
+/// \brief number of threads decoding images of a directory <br>
+DEFINE_uint32(n_dec, 0, num_decode_threads_message);
+
+/// \brief process every N-th frame <br>
+DEFINE_uint32(stride, 1, stride_message);
+
+/// \brief processing rate the stride is chosen for <br>
+DEFINE_double(target_fps, 0, target_fps_message);
+
+/// \brief number of workers processing segments of a video file <br>
+DEFINE_uint32(seg_workers, 0, seg_workers_message);
+
+/// \brief keyframe interval segment boundaries are aligned to <br>
+DEFINE_uint32(seg_gop, 250, seg_gop_message);
+
 /// \brief device the target device for age gender detection on <br>
 DEFINE_string(d_ag, "CPU", target_device_message_ag);
 
@@ -119,9 +340,35 @@ DEFINE_string(d_hp, "CPU", target_device_message_hp);
 /// \brief device the target device for head pose detection on <br>
 DEFINE_uint32(n_hp, 1, num_batch_hp_message);
 
+/// \brief Define parameter for structured results output<br>
+/// It is an optional parameter
+DEFINE_string(ro, "", results_output_message);
+
+/// \brief Define parameter for structured results format<br>
+/// It is an optional parameter
+DEFINE_string(ro_fmt, "jsonl", results_format_message);
+
+/// \brief Define parameter for dropping structured results on a full queue<br>
+/// It is an optional parameter
+DEFINE_bool(ro_drop, false, results_drop_message);
+
+/// \brief Define parameter for server mode socket<br>
+/// It is an optional parameter
+DEFINE_string(server, "", server_message);
+
+/// \brief Define parameter for server batching deadline<br>
+/// It is an optional parameter
+DEFINE_double(server_wait, 5.0, server_wait_message);
+
 /// \brief Enable per-layer performance report
 DEFINE_bool(pc, false, performance_counter_message);
 
+/// \brief Number of hottest layers in the performance report
+DEFINE_uint32(pc_top, 10, performance_counter_top_message);
+
+/// \brief Path prefix for the exported performance report
+DEFINE_string(pc_out, "", performance_counter_out_message);
+
 /// @brief clDNN custom kernels path <br>
 /// Default is ./lib
 DEFINE_string(c, "", custom_cldnn_message);
@@ -146,6 +393,18 @@ DEFINE_bool(no_wait, false, no_wait_for_keypress_message);
 /// It is an optional parameter
 DEFINE_bool(no_show, false, no_show_processed_video);
 
+/// \brief Define parameter for annotated output video or image sequence<br>
+/// It is an optional parameter
+DEFINE_string(o, "", output_message);
+
+/// \brief Define parameter for output video codec<br>
+/// It is an optional parameter
+DEFINE_string(o_fourcc, "MJPG", output_fourcc_message);
+
+/// \brief Define parameter for output writer queue size<br>
+/// It is an optional parameter
+DEFINE_uint32(o_queue, 16, output_queue_message);
+
 /**
 * \brief This function show a help message
 */
@@ -156,20 +415,61 @@ static void showUsage() {
     std::cout << std::endl;
     std::cout << "    -h                         " << help_message << std::endl;
     std::cout << "    -i \"<path>\"                " << video_message << std::endl;
+    std::cout << "    -shm_timeout \"<ms>\"        " << shm_timeout_message << std::endl;
     std::cout << "    -m \"<path>\"                " << face_detection_model_message<< std::endl;
     std::cout << "    -m_ag \"<path>\"             " << age_gender_model_message << std::endl;
     std::cout << "    -m_hp \"<path>\"             " << head_pose_model_message << std::endl;
+    std::cout << "    -m_attr \"<list>\"           " << attribute_models_message << std::endl;
+    std::cout << "    -ab_m \"<path>\"             " << ab_model_message << std::endl;
+    std::cout << "    -ab_m_ag \"<path>\"          " << ab_age_gender_model_message << std::endl;
+    std::cout << "    -ab_m_hp \"<path>\"          " << ab_head_pose_model_message << std::endl;
+    std::cout << "    -ab_frames \"<num>\"         " << ab_frames_message << std::endl;
     std::cout << "      -l \"<absolute_path>\"     " << custom_cpu_library_message << std::endl;
     std::cout << "          Or" << std::endl;
     std::cout << "      -c \"<absolute_path>\"     " << custom_cldnn_message << std::endl;
     std::cout << "    -d \"<device>\"              " << target_device_message << std::endl;
     std::cout << "    -d_ag \"<device>\"           " << target_device_message_ag << std::endl;
     std::cout << "    -d_hp \"<device>\"           " << target_device_message_hp << std::endl;
+    std::cout << "    -backend \"<name>\"          " << backend_message << std::endl;
+    std::cout << "    -stub_latency \"<list>\"     " << stub_latency_message << std::endl;
+    std::cout << "    -stub_faces \"<num>\"        " << stub_faces_message << std::endl;
+    std::cout << "    -stub_seed \"<num>\"         " << stub_seed_message << std::endl;
+    std::cout << "    -fd_reshape \"<size>\"       " << fd_reshape_message << std::endl;
+    std::cout << "    -fd_tiles \"<grid>\"         " << fd_tiles_message << std::endl;
+    std::cout << "    -fd_tile_overlap \"<frac>\"  " << fd_tile_overlap_message << std::endl;
+    std::cout << "    -fd_tile_full              " << fd_tile_full_message << std::endl;
+    std::cout << "    -fd_tile_nms \"<iou>\"       " << fd_tile_nms_message << std::endl;
+    std::cout << "    -fd_tile_async             " << fd_tile_async_message << std::endl;
+    std::cout << "    -spec                      " << spec_message << std::endl;
+    std::cout << "    -spec_iou \"<iou>\"          " << spec_iou_message << std::endl;
+    std::cout << "    -attr_u8                   " << attr_u8_message << std::endl;
+    std::cout << "    -attr_mean \"<mean>\"        " << attr_mean_message << std::endl;
+    std::cout << "    -attr_std \"<std>\"          " << attr_std_message << std::endl;
+    std::cout << "    -det_cache \"<path>\"        " << det_cache_message << std::endl;
+    std::cout << "    -det_cache_crops           " << det_cache_crops_message << std::endl;
+    std::cout << "    -mb_frames \"<num>\"         " << mb_frames_message << std::endl;
+    std::cout << "    -mb_wait \"<ms>\"            " << mb_wait_message << std::endl;
+    std::cout << "    -n_fd \"<num>\"              " << num_batch_fd_message << std::endl;
+    std::cout << "    -n_dec \"<num>\"             " << num_decode_threads_message << std::endl;
+    std::cout << "    -stride \"<num>\"            " << stride_message << std::endl;
+    std::cout << "    -target_fps \"<fps>\"        " << target_fps_message << std::endl;
+    std::cout << "    -seg_workers \"<num>\"       " << seg_workers_message << std::endl;
+    std::cout << "    -seg_gop \"<num>\"           " << seg_gop_message << std::endl;
     std::cout << "    -n_ag \"<num>\"              " << num_batch_ag_message << std::endl;
     std::cout << "    -n_hp \"<num>\"              " << num_batch_hp_message << std::endl;
     std::cout << "    -no_wait                   " << no_wait_for_keypress_message << std::endl;
     std::cout << "    -no_show                   " << no_show_processed_video << std::endl;
+    std::cout << "    -o \"<path>\"                " << output_message << std::endl;
+    std::cout << "    -o_fourcc \"<code>\"         " << output_fourcc_message << std::endl;
+    std::cout << "    -o_queue \"<num>\"           " << output_queue_message << std::endl;
+    std::cout << "    -server \"<path>\"           " << server_message << std::endl;
+    std::cout << "    -server_wait \"<ms>\"        " << server_wait_message << std::endl;
     std::cout << "    -pc                        " << performance_counter_message << std::endl;
+    std::cout << "    -pc_top \"<num>\"            " << performance_counter_top_message << std::endl;
+    std::cout << "    -pc_out \"<prefix>\"         " << performance_counter_out_message << std::endl;
     std::cout << "    -r                         " << raw_output_message << std::endl;
+    std::cout << "    -ro \"<path>\"               " << results_output_message << std::endl;
+    std::cout << "    -ro_fmt \"<format>\"         " << results_format_message << std::endl;
+    std::cout << "    -ro_drop                   " << results_drop_message << std::endl;
     std::cout << "    -t                         " << thresh_output_message << std::endl;
 }
@@ -0,0 +1,262 @@
+/*
+// Copyright (c) 2018 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma once
+
+#include <string>
+#include <chrono>
+#include <thread>
+#include <stdexcept>
+#include <cstring>
+#include <cerrno>
+#include <cstdint>
+#include <algorithm>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+#include <opencv2/opencv.hpp>
+#include <opencv2/videoio/videoio_c.h>
+#include <samples/slog.hpp>
+
+#include "shm_ring.hpp"
+
+/**
+* \brief Source of BGR frames for the main loop.
+* grab() moves to the next frame and retrieve() makes it available as a cv::Mat, so a source can
+* skip frames cheaply by grabbing without retrieving.
+*/
+class FrameSource {
+public:
+    virtual ~FrameSource() {}
+
+    virtual bool grab() = 0;
+    virtual bool retrieve(cv::Mat &frame) = 0;
+
+    /** Time stamp of the last retrieved frame, in milliseconds **/
+    virtual double timestampMs() = 0;
+    virtual cv::Size frameSize() const = 0;
+    virtual double fps() const = 0;
+
+    /** Retrieved frames point into memory owned by somebody else and must not be drawn into **/
+    virtual bool zeroCopy() const {
+        return false;
+    }
+
+    virtual void printStatistics() const {}
+
+    bool read(cv::Mat &frame) {
+        return grab() && retrieve(frame);
+    }
+};
+
+/**
+* \brief Video file or camera read through cv::VideoCapture.
+* Cameras do not report stream positions, their frames are stamped with the time since opening.
+*/
+class VideoCaptureSource : public FrameSource {
+public:
+    explicit VideoCaptureSource(const std::string &input)
+        : _isCamera(input == "cam"), _start(std::chrono::high_resolution_clock::now()) {
+        if (!(_isCamera ? _cap.open(0) : _cap.open(input))) {
+            throw std::logic_error("Cannot open input file or camera: " + input);
+        }
+    }
+
+    bool grab() override {
+        return _cap.grab();
+    }
+
+    bool retrieve(cv::Mat &frame) override {
+        return _cap.retrieve(frame);
+    }
+
+    double timestampMs() override {
+        if (_isCamera) {
+            typedef std::chrono::duration<double, std::ratio<1, 1000>> ms;
+            return std::chrono::duration_cast<ms>(std::chrono::high_resolution_clock::now() - _start).count();
+        }
+        return _cap.get(CV_CAP_PROP_POS_MSEC);
+    }
+
+    cv::Size frameSize() const override {
+        return cv::Size(static_cast<int>(_cap.get(CV_CAP_PROP_FRAME_WIDTH)),
+                        static_cast<int>(_cap.get(CV_CAP_PROP_FRAME_HEIGHT)));
+    }
+
+    double fps() const override {
+        return _cap.get(CV_CAP_PROP_FPS);
+    }
+
+    /** Number of frames the container reports, 0 for cameras and streams without an index **/
+    int64_t frameCount() const {
+        return _isCamera ? 0 : std::max<int64_t>(0, static_cast<int64_t>(_cap.get(CV_CAP_PROP_FRAME_COUNT)));
+    }
+
+    /** Moves to a frame of a video file, the next grab() returns it **/
+    bool seek(int64_t frameIndex) {
+        return !_isCamera && _cap.set(CV_CAP_PROP_POS_FRAMES, static_cast<double>(frameIndex));
+    }
+
+private:
+    const bool _isCamera;
+    std::chrono::high_resolution_clock::time_point _start;
+    cv::VideoCapture _cap;
+};
+
+#ifndef _WIN32
+/**
+* \brief Frames published by another process into a shared memory ring (see shm_ring.hpp).
+* Retrieved frames are wrapped in place, so they stay valid only until the producer reuses the slot.
+* The source always moves to the newest frame; skipped sequence numbers are counted as dropped and
+* frames the producer overwrote while they were still in use are counted as overrun.
+*/
+class ShmFrameSource : public FrameSource {
+public:
+    ShmFrameSource(const std::string &name, int timeoutMs) : _name(name), _timeoutMs(timeoutMs) {
+        int fd = shm_open(name.c_str(), O_RDONLY, 0);
+        if (fd < 0) {
+            throw std::logic_error("Cannot open shared memory " + name + ": " + std::strerror(errno));
+        }
+        struct stat st;
+        if (fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(ShmRingHeader)) {
+            ::close(fd);
+            throw std::logic_error("Shared memory " + name + " is too small for a frame ring");
+        }
+        _size = st.st_size;
+        void *mapped = mmap(nullptr, _size, PROT_READ, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (mapped == MAP_FAILED) {
+            throw std::logic_error("Cannot map shared memory " + name + ": " + std::strerror(errno));
+        }
+        _ring = static_cast<ShmRingHeader *>(mapped);
+
+        if (_ring->magic != shmRingMagic || _ring->version != shmRingVersion) {
+            munmap(_ring, _size);
+            throw std::logic_error("Shared memory " + name + " does not hold a frame ring of version " +
+                                   std::to_string(shmRingVersion));
+        }
+        if (_ring->stride < _ring->width * 3 || _ring->slotCount == 0 ||
+            _ring->slotSize < ShmRingLayout::slotSize(_ring->stride, _ring->height) ||
+            _ring->dataOffset + _ring->slotSize * _ring->slotCount > _size) {
+            munmap(_ring, _size);
+            throw std::logic_error("Shared memory " + name + " has an inconsistent frame ring header");
+        }
+        _lastSequence = _ring->writeSequence.load(std::memory_order_acquire);
+        if (_lastSequence > 0) {
+            _lastSequence--;  // start with the newest frame that is already there
+        }
+    }
+
+    ~ShmFrameSource() override {
+        if (_ring) {
+            munmap(_ring, _size);
+        }
+    }
+
+    bool grab() override {
+        auto start = std::chrono::steady_clock::now();
+        while (true) {
+            uint64_t latest = _ring->writeSequence.load(std::memory_order_acquire);
+            if (latest > _lastSequence) {
+                _dropped += latest - _lastSequence - 1;
+                _grabbed = latest;
+                _lastSequence = latest;
+                _pending = true;
+                return true;
+            }
+            if (_ring->producerClosed.load(std::memory_order_acquire)) {
+                return false;
+            }
+            if (std::chrono::steady_clock::now() - start > std::chrono::milliseconds(_timeoutMs)) {
+                slog::warn << "No frame from shared memory " << _name << " for " << _timeoutMs << " ms" << slog::endl;
+                return false;
+            }
+            std::this_thread::sleep_for(std::chrono::microseconds(200));
+        }
+    }
+
+    bool retrieve(cv::Mat &frame) override {
+        checkOverrun();
+        if (!_pending) {
+            return false;  // the last grab() found no new frame
+        }
+        _pending = false;
+        ShmSlotHeader *slot = ShmRingLayout::slot(_ring, _grabbed);
+        if (slot->sequence.load(std::memory_order_acquire) != _grabbed) {
+            // already reused by the producer, the next grab() moves on to a newer frame
+            _overrun++;
+            return grab() && retrieve(frame);
+        }
+        _timestampMs = slot->timestampMs;
+        frame = cv::Mat(_ring->height, _ring->width, CV_8UC3, ShmRingLayout::pixels(slot), _ring->stride);
+        _inUse = _grabbed;
+        _received++;
+        return true;
+    }
+
+    double timestampMs() override {
+        return _timestampMs;
+    }
+
+    cv::Size frameSize() const override {
+        return cv::Size(_ring->width, _ring->height);
+    }
+
+    double fps() const override {
+        return _ring->fps;
+    }
+
+    bool zeroCopy() const override {
+        return true;
+    }
+
+    void printStatistics() const override {
+        slog::info << "Shared memory input (" << _name << "): " << _received << " frames received, "
+                   << _dropped << " dropped in sequence gaps, " << _overrun << " overwritten while in use" << slog::endl;
+    }
+
+private:
+    void checkOverrun() {
+        if (_inUse == 0) {
+            return;
+        }
+        if (ShmRingLayout::slot(_ring, _inUse)->sequence.load(std::memory_order_acquire) != _inUse) {
+            _overrun++;
+        }
+        _inUse = 0;
+    }
+
+    std::string _name;
+    const int _timeoutMs;
+    size_t _size = 0;
+    ShmRingHeader *_ring = nullptr;
+    uint64_t _lastSequence = 0;
+    uint64_t _grabbed = 0;
+    uint64_t _inUse = 0;
+    bool _pending = false;
+    double _timestampMs = 0;
+
+    uint64_t _received = 0;
+    uint64_t _dropped = 0;
+    uint64_t _overrun = 0;
+};
+#endif
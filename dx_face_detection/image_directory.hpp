@@ -0,0 +1,155 @@
+/*
+// Copyright (c) 2018 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma once
+
+#include <string>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <algorithm>
+#include <cctype>
+
+#ifdef _WIN32
+#include <os/windows/w_dirent.h>
+#else
+#include <dirent.h>
+#endif
+
+#include <opencv2/opencv.hpp>
+
+#include "bounded_queue.hpp"
+
+inline bool isDirectory(const std::string &path) {
+    DIR *dir = opendir(path.c_str());
+    if (dir == nullptr) {
+        return false;
+    }
+    closedir(dir);
+    return true;
+}
+
+/**
+* \brief Returns the sorted paths of all files in the directory that have a common image extension
+*/
+inline std::vector<std::string> listImageFiles(const std::string &directory) {
+    static const char *extensions[] = {".jpg", ".jpeg", ".png", ".bmp", ".tif", ".tiff", ".ppm", ".pgm"};
+    std::vector<std::string> files;
+    DIR *dir = opendir(directory.c_str());
+    if (dir == nullptr) {
+        return files;
+    }
+    while (struct dirent *entry = readdir(dir)) {
+        std::string name = entry->d_name;
+        auto dot = name.rfind('.');
+        if (dot == std::string::npos) {
+            continue;
+        }
+        std::string ext = name.substr(dot);
+        std::transform(ext.begin(), ext.end(), ext.begin(), [](unsigned char c) { return std::tolower(c); });
+        for (auto &&known : extensions) {
+            if (ext == known) {
+                files.push_back(directory + "/" + name);
+                break;
+            }
+        }
+    }
+    closedir(dir);
+    std::sort(files.begin(), files.end());
+    return files;
+}
+
+/// @brief One image decoded by ParallelImageDecoder, index is its position in the file list
+struct DecodedImage {
+    size_t index = 0;
+    std::string path;
+    cv::Mat image;
+};
+
+/**
+* \brief Decodes a list of image files on a pool of worker threads.
+* Images are handed out in completion order through a bounded queue, so decoding runs
+* at most a queue length ahead of inference. Files that cannot be decoded are skipped and counted.
+*/
+class ParallelImageDecoder {
+public:
+    ParallelImageDecoder(const std::vector<std::string> &files, size_t numThreads, size_t queueSize)
+        : _files(files), _queue(queueSize), _active(numThreads ? numThreads : 1) {
+        for (size_t i = 0, n = _active; i < n; i++) {
+            _workers.emplace_back(&ParallelImageDecoder::run, this);
+        }
+    }
+
+    ~ParallelImageDecoder() {
+        _queue.close();
+        for (auto &&worker : _workers) {
+            worker.join();
+        }
+    }
+
+    /** Blocks until the next image is decoded, returns false when all files were handed out **/
+    bool next(DecodedImage &image) {
+        return _queue.pop(image);
+    }
+
+    size_t failed() const {
+        return _failed;
+    }
+
+    /** Sum of the decode times of all workers, in milliseconds **/
+    double decodeTimeMs() const {
+        return _decodeUs / 1000.0;
+    }
+
+    size_t numThreads() const {
+        return _workers.size();
+    }
+
+private:
+    void run() {
+        typedef std::chrono::duration<double, std::ratio<1, 1000000>> us;
+        for (size_t index = _next++; index < _files.size(); index = _next++) {
+            auto t0 = std::chrono::high_resolution_clock::now();
+            DecodedImage decoded;
+            decoded.index = index;
+            decoded.path = _files[index];
+            decoded.image = cv::imread(decoded.path, cv::IMREAD_COLOR);
+            auto t1 = std::chrono::high_resolution_clock::now();
+            _decodeUs += static_cast<long long>(std::chrono::duration_cast<us>(t1 - t0).count());
+
+            if (decoded.image.empty()) {
+                _failed++;
+                continue;
+            }
+            if (!_queue.push(std::move(decoded))) {
+                break;  // consumer went away
+            }
+        }
+        if (--_active == 0) {
+            _queue.close();
+        }
+    }
+
+    const std::vector<std::string> _files;
+    BoundedQueue<DecodedImage> _queue;
+    std::atomic<size_t> _active;
+    std::atomic<size_t> _next{0};
+    std::atomic<size_t> _failed{0};
+    std::atomic<long long> _decodeUs{0};
+    std::vector<std::thread> _workers;
+};
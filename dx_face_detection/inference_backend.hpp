@@ -0,0 +1,343 @@
+/*
+// Copyright (c) 2018 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma once
+
+#include <string>
+#include <vector>
+#include <map>
+#include <memory>
+#include <functional>
+#include <future>
+#include <thread>
+#include <chrono>
+#include <random>
+#include <sstream>
+#include <cstdio>
+#include <cmath>
+#include <algorithm>
+#include <stdexcept>
+
+#include <inference_engine.hpp>
+
+/**
+* \brief One infer request of a network loaded by an InferenceBackend.
+* Inputs are written into and outputs read from the blobs returned by getBlob().
+*/
+class BackendRequest {
+public:
+    typedef std::shared_ptr<BackendRequest> Ptr;
+
+    virtual ~BackendRequest() {}
+
+    virtual InferenceEngine::Blob::Ptr getBlob(const std::string &name) = 0;
+
+    /** Starts inference of the input batch, of which the first items (frames or faces) were filled **/
+    virtual void startAsync(int items) = 0;
+
+    virtual void wait() = 0;
+
+    /** The callback runs on the thread that completes the request **/
+    virtual void setCompletionCallback(const std::function<void()> &callback) = 0;
+
+    virtual std::map<std::string, InferenceEngine::InferenceEngineProfileInfo> performanceCounts() const = 0;
+};
+
+/**
+* \brief A network loaded for execution, creates the infer requests the detectors run on
+*/
+class InferenceBackend {
+public:
+    typedef std::shared_ptr<InferenceBackend> Ptr;
+
+    virtual ~InferenceBackend() {}
+
+    virtual BackendRequest::Ptr createRequest() = 0;
+};
+
+// -------------------------Inference Engine------------------------------------------------------------------------
+
+class IEBackendRequest : public BackendRequest {
+public:
+    explicit IEBackendRequest(InferenceEngine::InferRequest::Ptr request) : _request(request) {}
+
+    InferenceEngine::Blob::Ptr getBlob(const std::string &name) override {
+        return _request->GetBlob(name);
+    }
+
+    void startAsync(int) override {
+        _request->StartAsync();
+    }
+
+    void wait() override {
+        _request->Wait(InferenceEngine::IInferRequest::WaitMode::RESULT_READY);
+    }
+
+    void setCompletionCallback(const std::function<void()> &callback) override {
+        _request->SetCompletionCallback(callback);
+    }
+
+    std::map<std::string, InferenceEngine::InferenceEngineProfileInfo> performanceCounts() const override {
+        return _request->GetPerformanceCounts();
+    }
+
+private:
+    InferenceEngine::InferRequest::Ptr _request;
+};
+
+class IEBackend : public InferenceBackend {
+public:
+    explicit IEBackend(InferenceEngine::ExecutableNetwork network) : _network(network) {}
+
+    BackendRequest::Ptr createRequest() override {
+        return std::make_shared<IEBackendRequest>(_network.CreateInferRequestPtr());
+    }
+
+private:
+    InferenceEngine::ExecutableNetwork _network;
+};
+
+// -------------------------Stub for load tests without models------------------------------------------------------
+
+/**
+* \brief Latency of a stub inference in milliseconds: a base distribution plus a fixed cost per batch item.
+* Written as "<distribution>:<a>[,<b>][+<ms per item>]" where the distribution is one of
+*   fixed:<ms>, uniform:<min>,<max>, normal:<mean>,<stddev>, lognormal:<median>,<sigma of log>
+* e.g. "normal:4,0.5+1.2" takes about 4 ms for the request and another 1.2 ms for every face of the batch.
+*/
+class LatencyModel {
+public:
+    LatencyModel() {}
+
+    static LatencyModel parse(const std::string &spec) {
+        LatencyModel model;
+        const size_t colon = spec.find(':');
+        const std::string kind = spec.substr(0, colon);
+        std::string params = colon == std::string::npos ? "" : spec.substr(colon + 1);
+        const size_t plus = params.find('+');
+        if (plus != std::string::npos) {
+            model._msPerItem = parseNumber(params.substr(plus + 1), spec);
+            params = params.substr(0, plus);
+        }
+        const size_t comma = params.find(',');
+        model._a = parseNumber(params.substr(0, comma), spec);
+        if (comma != std::string::npos) {
+            model._b = parseNumber(params.substr(comma + 1), spec);
+        }
+
+        const bool twoParams = comma != std::string::npos;
+        if (kind == "fixed" && !twoParams) {
+            model._kind = Fixed;
+        } else if (kind == "uniform" && twoParams && model._b >= model._a) {
+            model._kind = Uniform;
+        } else if (kind == "normal" && twoParams) {
+            model._kind = Normal;
+        } else if (kind == "lognormal" && twoParams && model._a > 0) {
+            model._kind = LogNormal;
+        } else {
+            throw std::logic_error("Invalid stub latency: " + spec);
+        }
+        return model;
+    }
+
+    /** Never negative, so a wide normal distribution does not end before it started **/
+    double sampleMs(std::mt19937 &rng, int items) const {
+        double ms = _a;
+        switch (_kind) {
+        case Fixed:
+            break;
+        case Uniform:
+            ms = std::uniform_real_distribution<double>(_a, _b)(rng);
+            break;
+        case Normal:
+            ms = std::normal_distribution<double>(_a, _b)(rng);
+            break;
+        case LogNormal:
+            ms = std::lognormal_distribution<double>(std::log(_a), _b)(rng);
+            break;
+        }
+        return std::max(0.0, ms + _msPerItem * items);
+    }
+
+private:
+    enum Kind { Fixed, Uniform, Normal, LogNormal };
+
+    static double parseNumber(const std::string &text, const std::string &spec) {
+        double value = 0;
+        char tail = 0;
+        if (std::sscanf(text.c_str(), "%lf%c", &value, &tail) != 1 || value < 0) {
+            throw std::logic_error("Invalid stub latency: " + spec);
+        }
+        return value;
+    }
+
+    Kind _kind = Fixed;
+    double _a = 0;
+    double _b = 0;
+    double _msPerItem = 0;
+};
+
+/**
+* \brief Parses "<network>=<latency>" entries separated by ';', see LatencyModel for the latency format
+*/
+inline std::map<std::string, LatencyModel> parseStubLatencies(const std::string &list) {
+    std::map<std::string, LatencyModel> latencies;
+    std::stringstream entries(list);
+    std::string entry;
+    while (std::getline(entries, entry, ';')) {
+        if (entry.empty()) {
+            continue;
+        }
+        const size_t equals = entry.find('=');
+        if (equals == std::string::npos || equals == 0) {
+            throw std::logic_error("Invalid stub latency entry: " + entry + ", should be <network>=<latency>");
+        }
+        latencies[entry.substr(0, equals)] = LatencyModel::parse(entry.substr(equals + 1));
+    }
+    return latencies;
+}
+
+/**
+* \brief What the stub backend needs to know about a network instead of its IR: the blobs it reads and
+* writes and how to make up results. Every detector describes itself this way in describeStub().
+*/
+struct StubNetwork {
+    struct Tensor {
+        std::string name;
+        InferenceEngine::Precision precision;
+        InferenceEngine::SizeVector dims;  // NCHW
+    };
+    typedef std::map<std::string, InferenceEngine::Blob::Ptr> BlobMap;
+
+    /** Name the latency is configured under, see parseStubLatencies **/
+    std::string key;
+    std::string defaultLatency = "fixed:1";
+    std::vector<Tensor> inputs;
+    std::vector<Tensor> outputs;
+    /** Writes synthetic results for the first items of the batch; inference is the index of the inference on the request **/
+    std::function<void(std::mt19937 &rng, int items, size_t inference, BlobMap &outputs)> fill;
+};
+
+/**
+* \brief Request of the stub backend. Every inference runs on its own thread, which sleeps for a latency
+* drawn from the latency model and then fills the outputs, so concurrent requests overlap like on a device
+* with unlimited streams. Latencies and results only depend on the seed and on the calls made on the request.
+*/
+class StubBackendRequest : public BackendRequest {
+public:
+    StubBackendRequest(const StubNetwork &network, const LatencyModel &latency, uint32_t seed)
+        : _network(network), _latency(latency), _rng(seed) {
+        for (auto &&tensor : network.inputs) {
+            _inputs[tensor.name] = makeBlob(tensor);
+        }
+        for (auto &&tensor : network.outputs) {
+            _outputs[tensor.name] = makeBlob(tensor);
+        }
+    }
+
+    ~StubBackendRequest() override {
+        if (_inference.valid()) {
+            _inference.wait();
+        }
+    }
+
+    InferenceEngine::Blob::Ptr getBlob(const std::string &name) override {
+        auto blob = _inputs.find(name);
+        if (blob != _inputs.end()) {
+            return blob->second;
+        }
+        blob = _outputs.find(name);
+        if (blob == _outputs.end()) {
+            throw std::logic_error("Stub of " + _network.key + " has no blob " + name);
+        }
+        return blob->second;
+    }
+
+    void startAsync(int items) override {
+        if (_inference.valid()) {
+            _inference.wait();
+        }
+        const auto start = std::chrono::high_resolution_clock::now();
+        const auto end = start + std::chrono::duration_cast<std::chrono::high_resolution_clock::duration>(
+            std::chrono::duration<double, std::milli>(_latency.sampleMs(_rng, items)));
+        const size_t inference = _inferences++;
+        _inference = std::async(std::launch::async, [this, end, items, inference] {
+            std::this_thread::sleep_until(end);
+            if (_network.fill) {
+                _network.fill(_rng, items, inference, _outputs);
+            }
+            if (_callback) {
+                _callback();
+            }
+        });
+    }
+
+    void wait() override {
+        if (_inference.valid()) {
+            _inference.get();
+        }
+    }
+
+    void setCompletionCallback(const std::function<void()> &callback) override {
+        _callback = callback;
+    }
+
+    std::map<std::string, InferenceEngine::InferenceEngineProfileInfo> performanceCounts() const override {
+        return {};
+    }
+
+private:
+    static InferenceEngine::Blob::Ptr makeBlob(const StubNetwork::Tensor &tensor) {
+        const InferenceEngine::TensorDesc desc(tensor.precision, tensor.dims, InferenceEngine::Layout::ANY);
+        InferenceEngine::Blob::Ptr blob;
+        if (tensor.precision == InferenceEngine::Precision::U8) {
+            blob = InferenceEngine::make_shared_blob<uint8_t>(desc);
+        } else if (tensor.precision == InferenceEngine::Precision::FP32) {
+            blob = InferenceEngine::make_shared_blob<float>(desc);
+        } else {
+            throw std::logic_error("Stub blob " + tensor.name + " should be U8 or FP32");
+        }
+        blob->allocate();
+        return blob;
+    }
+
+    const StubNetwork _network;
+    const LatencyModel _latency;
+    std::mt19937 _rng;
+    StubNetwork::BlobMap _inputs;
+    StubNetwork::BlobMap _outputs;
+    std::function<void()> _callback;
+    std::future<void> _inference;
+    size_t _inferences = 0;
+};
+
+class StubBackend : public InferenceBackend {
+public:
+    StubBackend(const StubNetwork &network, const LatencyModel &latency, uint32_t seed)
+        : _network(network), _latency(latency), _seed(seed ^ static_cast<uint32_t>(std::hash<std::string>()(network.key))) {}
+
+    /** Every request gets its own random sequence, the same one on every run **/
+    BackendRequest::Ptr createRequest() override {
+        return std::make_shared<StubBackendRequest>(_network, _latency, _seed + _requests++);
+    }
+
+private:
+    const StubNetwork _network;
+    const LatencyModel _latency;
+    const uint32_t _seed;
+    uint32_t _requests = 0;
+};
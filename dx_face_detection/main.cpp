@@ -28,10 +28,23 @@
 #include <chrono>
 #include <vector>
 #include <string>
+#include <sstream>
 #include <utility>
 #include <algorithm>
 #include <iterator>
 #include <map>
+#include <deque>
+#include <future>
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include <condition_variable>
+#include <csignal>
+#include <cstdio>
+#include <cmath>
+#include <cstdlib>
+#include <cerrno>
+#include <climits>
 
 #include <inference_engine.hpp>
 
@@ -39,6 +52,20 @@
 #include <samples/slog.hpp>
 
 #include "face_detection.hpp"
+#include "output_writer.hpp"
+#include "results_writer.hpp"
+#include "image_directory.hpp"
+#include "frame_source.hpp"
+#include "unix_socket.hpp"
+#include "perf_counters.hpp"
+#include "box_utils.hpp"
+#include "detection_utils.hpp"
+#include "ab_compare.hpp"
+#include "inference_backend.hpp"
+#include "video_segments.hpp"
+#include "speculation.hpp"
+#include "cpu_accounting.hpp"
+#include "detection_cache.hpp"
 //#include "mkldnn/mkldnn_extension_ptr.hpp"		// deprecated 4.20
 #include <ext_list.hpp>
 
@@ -50,6 +77,26 @@
 
 using namespace InferenceEngine;
 
+/** Values of -attr_mean: none, one for all channels or one per B, G and R channel of the face crops **/
+std::vector<float> parseAttributeMean() {
+    std::vector<float> mean;
+    std::stringstream values(FLAGS_attr_mean);
+    std::string value;
+    while (std::getline(values, value, ',')) {
+        char *end = nullptr;
+        const float number = std::strtof(value.c_str(), &end);
+        if (value.empty() || *end != '\0' || !std::isfinite(number)) {
+            throw std::logic_error("Parameter -attr_mean should be numbers separated by ',', but was: " + FLAGS_attr_mean);
+        }
+        mean.push_back(number);
+    }
+    if (mean.size() > 1 && mean.size() != 3) {
+        throw std::logic_error("Parameter -attr_mean should have one value or one per B, G and R channel, but has " +
+                               std::to_string(mean.size()));
+    }
+    return mean;
+}
+
 bool ParseAndCheckCommandLine(int argc, char *argv[]) {
     // ---------------------------Parsing and validation of input args--------------------------------------
     gflags::ParseCommandLineNonHelpFlags(&argc, &argv, true);
@@ -67,6 +114,10 @@ bool ParseAndCheckCommandLine(int argc, char *argv[]) {
         throw std::logic_error("Parameter -m is not set");
     }
 
+    if (FLAGS_n_fd < 1) {
+        throw std::logic_error("Parameter -n_fd cannot be 0");
+    }
+
     if (FLAGS_n_ag < 1) {
         throw std::logic_error("Parameter -n_ag cannot be 0");
     }
@@ -75,44 +126,95 @@ bool ParseAndCheckCommandLine(int argc, char *argv[]) {
         throw std::logic_error("Parameter -n_hp cannot be 0");
     }
 
+    if (!FLAGS_pc_out.empty()) {
+        FLAGS_pc = true;
+    }
+
+    if (FLAGS_o_queue < 1) {
+        throw std::logic_error("Parameter -o_queue cannot be 0");
+    }
+
+    if (!FLAGS_o.empty()) {
+        checkOutputPattern(FLAGS_o);
+    }
+
+    if ((!FLAGS_ab_m_ag.empty() && FLAGS_m_ag.empty()) || (!FLAGS_ab_m_hp.empty() && FLAGS_m_hp.empty())) {
+        throw std::logic_error("Parameters -ab_m_ag and -ab_m_hp need the variant A model in -m_ag and -m_hp");
+    }
+
+    if (FLAGS_fd_tile_overlap < 0 || FLAGS_fd_tile_overlap >= 1) {
+        throw std::logic_error("Parameter -fd_tile_overlap should be at least 0 and less than 1");
+    }
+
+    if (FLAGS_fd_tile_nms <= 0 || FLAGS_fd_tile_nms > 1) {
+        throw std::logic_error("Parameter -fd_tile_nms should be more than 0 and at most 1");
+    }
+
+    if (FLAGS_backend != "ie" && FLAGS_backend != "stub") {
+        throw std::logic_error("Parameter -backend should be ie or stub, but was: " + FLAGS_backend);
+    }
+
+    if (FLAGS_stride < 1) {
+        throw std::logic_error("Parameter -stride cannot be 0");
+    }
+
+    if (FLAGS_stub_faces <= 0) {
+        throw std::logic_error("Parameter -stub_faces should be more than 0");
+    }
+
+    if (FLAGS_attr_std <= 0) {
+        throw std::logic_error("Parameter -attr_std should be more than 0");
+    }
+    parseAttributeMean();
+
     return true;
 }
 
 // -------------------------Generic routines for detection networks-------------------------------------------------
 
 struct BaseDetection {
-    ExecutableNetwork net;
-    InferenceEngine::InferencePlugin * plugin = NULL;
-    InferRequest::Ptr request;
-    std::string & commandLineFlag;
+    InferenceBackend::Ptr backend;
+    BackendRequest::Ptr request;
+    std::string modelPath;
+    std::string deviceName;
     std::string topoName;
     const int maxBatch;
+    /** shared by copies of the detector, so counters of all requests end up in one place **/
+    std::shared_ptr<PerfCounterAggregator> perfCounters = std::make_shared<PerfCounterAggregator>();
 
-    BaseDetection(std::string &commandLineFlag, std::string topoName, int maxBatch)
-        : commandLineFlag(commandLineFlag), topoName(topoName), maxBatch(maxBatch) {}
+    BaseDetection(const std::string &modelPath, const std::string &deviceName, std::string topoName, int maxBatch)
+        : modelPath(modelPath), deviceName(deviceName), topoName(topoName), maxBatch(maxBatch) {}
 
     virtual ~BaseDetection() {}
 
-    ExecutableNetwork* operator ->() {
-        return &net;
-    }
     virtual InferenceEngine::CNNNetwork read()  = 0;
 
+    /** Used instead of read() by the stub backend: sets up what read() takes from the IR and describes the blobs **/
+    virtual StubNetwork describeStub() = 0;
+
+    /** Number of frames or faces in the batch that is submitted next **/
+    virtual int submittedItems() const {
+        return 1;
+    }
+
     virtual void submitRequest() {
         if (!enabled() || request == nullptr) return;
-        request->StartAsync();
+        request->startAsync(submittedItems());
     }
 
     virtual void wait() {
         if (!enabled()|| !request) return;
-        request->Wait(IInferRequest::WaitMode::RESULT_READY);
+        request->wait();
+        if (FLAGS_pc) {
+            perfCounters->add(request->performanceCounts());
+        }
     }
     mutable bool enablingChecked = false;
     mutable bool _enabled = false;
 
     bool enabled() const  {
         if (!enablingChecked) {
-            _enabled = !commandLineFlag.empty();
+            _enabled = !modelPath.empty();
             if (!_enabled) {
                 slog::info << topoName << " DISABLED" << slog::endl;
             }
@@ -125,7 +227,7 @@ struct BaseDetection {
             return;
         }
         slog::info << "Performance counts for " << topoName << slog::endl << slog::endl;
-        ::printPerformanceCounts(request->GetPerformanceCounts(), std::cout, false);
+        perfCounters->print(std::cout, FLAGS_pc_top);
     }
 };
 
@@ -135,22 +237,31 @@ struct FaceDetectionClass : BaseDetection {
     int maxProposalCount = 0;
     int objectSize = 0;
     int enquedFrames = 0;
+    int submittedFrames = 0;
     float width = 0;
     float height = 0;
+    std::vector<cv::Size> frameSizes;
     bool resultsFetched = false;
     std::vector<std::string> labels;
+    /** Input resolution to reshape the network to before loading; with an empty size and a pixel count
+        the input gets reshapeAspect (or the aspect ratio of the IR) at about reshapePixels pixels **/
+    cv::Size reshapeSize;
+    double reshapePixels = 0;
+    double reshapeAspect = 0;
+    cv::Size inputSize;
     using BaseDetection::operator=;
 
-    struct Result {
-        int label;
-        float confidence;
-        cv::Rect location;
-    };
+    typedef DetectionResult Result;
 
     std::vector<Result> results;
 
+    int submittedItems() const override {
+        return submittedFrames;
+    }
+
     void submitRequest() override {
         if (!enquedFrames) return;
+        submittedFrames = enquedFrames;
         enquedFrames = 0;
         resultsFetched = false;
         results.clear();
@@ -160,34 +271,63 @@ struct FaceDetectionClass : BaseDetection {
     void enqueue(const cv::Mat &frame) {
         if (!enabled()) return;
 
+        if (enquedFrames >= maxBatch) {
+            slog::warn << "Number of enqueued frames more than maximum(" << maxBatch << ") processed by Face detector" << slog::endl;
+            return;
+        }
         if (!request) {
-            request = net.CreateInferRequestPtr();
+            request = backend->createRequest();
+        }
+        if (!enquedFrames) {
+            frameSizes.clear();
         }
 
         width = frame.cols;
         height = frame.rows;
+        frameSizes.push_back(cv::Size(frame.cols, frame.rows));
 
-        auto  inputBlob = request->GetBlob(input);
+        auto  inputBlob = request->getBlob(input);
 
-        matU8ToBlob<uint8_t >(frame, inputBlob);
-		enquedFrames = 1;
+        matU8ToBlob<uint8_t >(frame, inputBlob, enquedFrames);
+		enquedFrames++;
     }
 
 
-    FaceDetectionClass() : BaseDetection(FLAGS_m, "Face Detection", 1) {}
+    explicit FaceDetectionClass(int maxBatch = 1, const std::string &modelPath = FLAGS_m, const std::string &deviceName = FLAGS_d)
+        : BaseDetection(modelPath, deviceName, "Face Detection", maxBatch) {}
     InferenceEngine::CNNNetwork read() override {
         slog::info << "Loading network files for Face Detection" << slog::endl;
         InferenceEngine::CNNNetReader netReader;
         /** Read network model **/
-        netReader.ReadNetwork(FLAGS_m);
-        /** Set batch size to 1 **/
+        netReader.ReadNetwork(modelPath);
+        /** Reshape the input, the detections stay normalized to the input so they map back to any frame size **/
+        InferenceEngine::ICNNNetwork::InputShapes inputShapes = netReader.getNetwork().getInputShapes();
+        if (inputShapes.size() == 1 && inputShapes.begin()->second.size() == 4) {
+            InferenceEngine::SizeVector &dims = inputShapes.begin()->second;  // NCHW
+            inputSize = cv::Size(static_cast<int>(dims[3]), static_cast<int>(dims[2]));
+            cv::Size size = reshapeSize;
+            if (size.area() <= 0 && reshapePixels > 0) {
+                size = sizeForPixels(reshapePixels, reshapeAspect > 0 ? reshapeAspect
+                                                                      : static_cast<double>(dims[3]) / dims[2]);
+            }
+            if (size.area() > 0 && size != inputSize) {
+                slog::info << "Reshaping Face Detection input from " << inputSize.width << "x" << inputSize.height
+                           << " to " << size.width << "x" << size.height << slog::endl;
+                dims[0] = maxBatch;
+                dims[2] = size.height;
+                dims[3] = size.width;
+                netReader.getNetwork().reshape(inputShapes);
+                inputSize = size;
+            }
+        }
+        /** Set batch size, more than one frame is only enqueued for image directories **/
         slog::info << "Batch size is set to  "<< maxBatch << slog::endl;
         netReader.getNetwork().setBatchSize(maxBatch);
         /** Extract model name and load it's weights **/
-        std::string binFileName = fileNameNoExt(FLAGS_m) + ".bin";
+        std::string binFileName = fileNameNoExt(modelPath) + ".bin";
         netReader.ReadWeights(binFileName);
         /** Read labels (if any)**/
-        std::string labelFileName = fileNameNoExt(FLAGS_m) + ".labels";
+        std::string labelFileName = fileNameNoExt(modelPath) + ".labels";
 
         std::ifstream inputFile(labelFileName);
         std::copy(std::istream_iterator<std::string>(inputFile),
@@ -247,56 +387,107 @@ struct FaceDetectionClass : BaseDetection {
         _output->setPrecision(Precision::FP32);
         _output->setLayout(Layout::NCHW);
 
-        slog::info << "Loading Face Detection model to the "<< FLAGS_d << " plugin" << slog::endl;
+        slog::info << "Loading Face Detection model to the "<< deviceName << " plugin" << slog::endl;
         input = inputInfo.begin()->first;
         return netReader.getNetwork();
     }
 
+    /**
+    * \brief Stub of face-detection-retail: about -stub_faces faces per frame (Poisson distributed) at
+    * positions that drift slowly from frame to frame, with confidences between 0.4 and 1.
+    */
+    StubNetwork describeStub() override {
+        inputSize = reshapeSize.area() > 0 ? reshapeSize :
+                    reshapePixels > 0 ? sizeForPixels(reshapePixels, reshapeAspect > 0 ? reshapeAspect : 1.0) :
+                    cv::Size(300, 300);
+        input = "data";
+        output = "detection_out";
+        maxProposalCount = 200;
+        objectSize = 7;
+
+        StubNetwork network;
+        network.key = "fd";
+        network.defaultLatency = "normal:12,1.5+2";
+        network.inputs.push_back({input, Precision::U8, {static_cast<size_t>(maxBatch), 3,
+                                  static_cast<size_t>(inputSize.height), static_cast<size_t>(inputSize.width)}});
+        network.outputs.push_back({output, Precision::FP32, {1, 1, static_cast<size_t>(maxProposalCount),
+                                                             static_cast<size_t>(objectSize)}});
+        const std::string outputName = output;
+        const int proposals = maxProposalCount;
+        const double meanFaces = FLAGS_stub_faces;
+        network.fill = [outputName, proposals, meanFaces](std::mt19937 &rng, int items, size_t inference,
+                                                          StubNetwork::BlobMap &outputs) {
+            float *detections = outputs[outputName]->buffer().as<float *>();
+            std::poisson_distribution<int> faceCount(meanFaces);
+            std::uniform_real_distribution<float> confidence(0.4f, 1.f);
+            int row = 0;
+            for (int item = 0; item < items; item++) {
+                const int faces = faceCount(rng);
+                for (int face = 0; face < faces && row < proposals - 1; face++, row++) {
+                    // every face slot has its own place and drifts around it over the frames
+                    const float phase = 0.05f * inference + face;
+                    const float size = 0.06f + 0.03f * (face % 3);
+                    const float x = 0.1f + 0.7f * std::fmod(0.618f * (face + 1), 1.f) + 0.03f * std::sin(phase);
+                    const float y = 0.1f + 0.6f * std::fmod(0.414f * (face + 1), 1.f) + 0.03f * std::cos(phase);
+                    float *d = detections + row * 7;
+                    d[0] = static_cast<float>(item);
+                    d[1] = 1;
+                    d[2] = confidence(rng);
+                    d[3] = x;
+                    d[4] = y;
+                    d[5] = x + size;
+                    d[6] = y + 1.5f * size;
+                }
+            }
+            detections[row * 7] = -1;  // end of detections
+        };
+        return network;
+    }
+
+    /** Input size with the given aspect ratio and about the given number of pixels, rounded to multiples of 16 **/
+    static cv::Size sizeForPixels(double pixels, double aspect) {
+        const double height = std::sqrt(pixels / aspect);
+        auto round16 = [](double value) { return std::max(16, static_cast<int>(std::lround(value / 16)) * 16); };
+        return cv::Size(round16(height * aspect), round16(height));
+    }
+
     void fetchResults() {
         if (!enabled()) return;
         results.clear();
         if (resultsFetched) return;
         resultsFetched = true;
-        const float *detections = request->GetBlob(output)->buffer().as<float *>();
-
-        for (int i = 0; i < maxProposalCount; i++) {
-            float image_id = detections[i * objectSize + 0];
-            Result r;
-            r.label = static_cast<int>(detections[i * objectSize + 1]);
-            r.confidence = detections[i * objectSize + 2];
-            if (r.confidence <= FLAGS_t) {
-                continue;
-            }
-
-            r.location.x = detections[i * objectSize + 3] * width;
-            r.location.y = detections[i * objectSize + 4] * height;
-            r.location.width = detections[i * objectSize + 5] * width - r.location.x;
-            r.location.height = detections[i * objectSize + 6] * height - r.location.y;
-
-            if ((image_id < 0) || (image_id >= maxBatch)) {  // indicates end of detections
-                break;
-            }
-            if (FLAGS_r) {
-                std::cout << "[" << i << "," << r.label << "] element, prob = " << r.confidence <<
-                          "    (" << r.location.x << "," << r.location.y << ")-(" << r.location.width << ","
-                          << r.location.height << ")"
-                          << ((r.confidence > FLAGS_t) ? " WILL BE RENDERED!" : "") << std::endl;
-            }
-
-            results.push_back(r);
-        }
+        const float *detections = request->getBlob(output)->buffer().as<float *>();
+        parseDetectionOutput(detections, maxProposalCount, objectSize, maxBatch, frameSizes, FLAGS_t, results,
+                             FLAGS_r ? &std::cout : nullptr);
     }
 };
 
-struct AgeGenderDetection : BaseDetection {
+/**
+* \brief Base of the second stage networks that run on face crops.
+* A network is described by its model, device and batch size; the input size comes from the IR.
+* Subclasses check the outputs they expect in checkOutputs() and turn them into face attributes in parse().
+*/
+struct AttributeNetwork : BaseDetection {
     std::string input;
-    std::string outputAge;
-    std::string outputGender;
+    cv::Size inputSize;
     int enquedFaces = 0;
+    /** U8 crops leave the conversion to float, mean and scale to the input preprocessing of the plugin **/
+    bool u8Input = FLAGS_attr_u8;
+
+    /** Face crops written into the input blob on the host, shared by copies of the network **/
+    struct InputStatistics {
+        std::atomic<uint64_t> faces{0};
+        std::atomic<uint64_t> bytes{0};
+        std::atomic<uint64_t> copyNs{0};
+    };
+    std::shared_ptr<InputStatistics> inputStatistics = std::make_shared<InputStatistics>();
 
+    AttributeNetwork(const std::string &modelPath, const std::string &deviceName, std::string topoName, int maxBatch)
+        : BaseDetection(modelPath, deviceName, topoName, maxBatch) {}
 
-    using BaseDetection::operator=;
-    AgeGenderDetection() : BaseDetection(FLAGS_m_ag, "Age Gender", FLAGS_n_ag) {}
+    int submittedItems() const override {
+        return enquedFaces;
+    }
 
     void submitRequest() override {
         if (!enquedFaces) return;
@@ -309,61 +500,175 @@ struct AgeGenderDetection : BaseDetection {
             return;
         }
         if (enquedFaces >= maxBatch) {
-            slog::warn << "Number of detected faces more than maximum(" << maxBatch << ") processed by Age Gender detector" << slog::endl;
+            slog::warn << "Number of detected faces more than maximum(" << maxBatch << ") processed by " << topoName << slog::endl;
             return;
         }
         if (!request) {
-            request = net.CreateInferRequestPtr();
+            request = backend->createRequest();
         }
 
-        auto  inputBlob = request->GetBlob(input);
+        auto  inputBlob = request->getBlob(input);
 
-        matU8ToBlob<float>(face, inputBlob, enquedFaces);
+        auto start = std::chrono::high_resolution_clock::now();
+        if (u8Input) {
+            matU8ToBlob<uint8_t>(face, inputBlob, enquedFaces);
+        } else {
+            matU8ToBlob<float>(face, inputBlob, enquedFaces);
+        }
+        inputStatistics->copyNs += std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::high_resolution_clock::now() - start).count();
+        inputStatistics->bytes += inputBlob->byteSize() / maxBatch;
+        inputStatistics->faces++;
         enquedFaces++;
     }
 
-    struct Result { float age; float maleProb;};
-    Result operator[] (int idx) const {
-        auto  genderBlob = request->GetBlob(outputGender);
-        auto  ageBlob    = request->GetBlob(outputAge);
-
-        return {ageBlob->buffer().as<float*>()[idx] * 100,
-                genderBlob->buffer().as<float*>()[idx * 2 + 1]};
+    /** Bytes and time of writing the face crops into the input blob, with what FP32 input would write **/
+    void printInputStatistics() const {
+        const uint64_t faces = inputStatistics->faces;
+        if (faces == 0) {
+            return;
+        }
+        const double bytesPerFace = static_cast<double>(inputStatistics->bytes) / faces;
+        const double copyUs = inputStatistics->copyNs / 1000.0 / faces;
+        slog::info << "   " << topoName << " input: " << (u8Input ? "U8" : "FP32") << ", " << faces << " faces, "
+                   << std::fixed << std::setprecision(0) << bytesPerFace << " bytes written per face"
+                   << (u8Input ? " (" + std::to_string(static_cast<uint64_t>(4 * bytesPerFace)) + " as FP32)" : std::string())
+                   << slog::endl;
+        slog::info << "     Avg host copy: " << std::setprecision(2) << copyUs << " us per face ("
+                   << bytesPerFace / copyUs << " MB/s)" << slog::endl;
     }
 
+    /** Stores the results for face idx of the last batch in face **/
+    virtual void parse(int idx, FaceRecord &face) const = 0;
+
+    /** Copy on the same loaded network, which needs a request of its own before it is used from another thread **/
+    virtual std::unique_ptr<AttributeNetwork> clone() const = 0;
+
     CNNNetwork read() override {
-        slog::info << "Loading network files for AgeGender" << slog::endl;
+        slog::info << "Loading network files for " << topoName << slog::endl;
         InferenceEngine::CNNNetReader netReader;
         /** Read network model **/
-        netReader.ReadNetwork(FLAGS_m_ag);
+        netReader.ReadNetwork(modelPath);
 
         /** Set batch size **/
         netReader.getNetwork().setBatchSize(maxBatch);
-        slog::info << "Batch size is set to " << netReader.getNetwork().getBatchSize() << " for Age Gender" << slog::endl;
-
+        slog::info << "Batch size is set to " << netReader.getNetwork().getBatchSize() << " for " << topoName << slog::endl;
 
         /** Extract model name and load it's weights **/
-        std::string binFileName = fileNameNoExt(FLAGS_m_ag) + ".bin";
+        std::string binFileName = fileNameNoExt(modelPath) + ".bin";
         netReader.ReadWeights(binFileName);
 
-        // -----------------------------------------------------------------------------------------------------
-
-        /** Age Gender network should have one input two outputs **/
         // ---------------------------Check inputs ------------------------------------------------------
-        slog::info << "Checking Age Gender inputs" << slog::endl;
+        slog::info << "Checking " << topoName << " inputs" << slog::endl;
         InferenceEngine::InputsDataMap inputInfo(netReader.getNetwork().getInputsInfo());
         if (inputInfo.size() != 1) {
-            throw std::logic_error("Age gender topology should have only one input");
+            throw std::logic_error(topoName + " topology should have only one input");
         }
         auto& inputInfoFirst = inputInfo.begin()->second;
-        inputInfoFirst->setPrecision(Precision::FP32);
+        inputInfoFirst->setPrecision(u8Input ? Precision::U8 : Precision::FP32);
         inputInfoFirst->getInputData()->setLayout(Layout::NCHW);
+        setInputNormalization(inputInfoFirst->getPreProcess());
         input = inputInfo.begin()->first;
+        const InferenceEngine::SizeVector inputDims = inputInfoFirst->getTensorDesc().getDims();
+        if (inputDims.size() == 4) {
+            inputSize = cv::Size(static_cast<int>(inputDims[3]), static_cast<int>(inputDims[2]));
+        }
         // -----------------------------------------------------------------------------------------------------
 
         // ---------------------------Check outputs ------------------------------------------------------
-        slog::info << "Checking Age Gender outputs" << slog::endl;
+        slog::info << "Checking " << topoName << " outputs" << slog::endl;
         InferenceEngine::OutputsDataMap outputInfo(netReader.getNetwork().getOutputsInfo());
+        checkOutputs(outputInfo);
+
+        slog::info << "Loading " << topoName << " model to the "<< deviceName << " plugin" << slog::endl;
+        _enabled = true;
+        return netReader.getNetwork();
+    }
+
+protected:
+    virtual void checkOutputs(InferenceEngine::OutputsDataMap &outputInfo) = 0;
+
+    /**
+    * \brief Lets the plugin subtract -attr_mean and divide by -attr_std while it converts the input to the
+    * precision of the network, for models that do not have the normalization folded into their first layer
+    */
+    static void setInputNormalization(InferenceEngine::PreProcessInfo &preProcess) {
+        const std::vector<float> mean = parseAttributeMean();
+        if (mean.empty() && FLAGS_attr_std == 1) {
+            return;
+        }
+        if (mean.size() > 1 && mean.size() != preProcess.getNumberOfChannels()) {
+            throw std::logic_error("Parameter -attr_mean should have one value or one per input channel");
+        }
+        preProcess.init(preProcess.getNumberOfChannels());
+        for (size_t c = 0; c < preProcess.getNumberOfChannels(); c++) {
+            preProcess[c]->meanValue = mean.empty() ? 0.f : mean[mean.size() > 1 ? c : 0];
+            preProcess[c]->stdScale = static_cast<float>(FLAGS_attr_std);
+        }
+        preProcess.setVariant(InferenceEngine::MEAN_VALUE);
+    }
+
+    /** Stub with an FP32 or U8 input of the given size and single value outputs, one per face **/
+    StubNetwork stubNetwork(const std::string &key, const cv::Size &size, const std::vector<std::string> &outputNames) {
+        input = "data";
+        inputSize = size;
+        StubNetwork network;
+        network.key = key;
+        network.defaultLatency = "normal:1.5,0.2+0.6";
+        network.inputs.push_back({input, u8Input ? Precision::U8 : Precision::FP32, {static_cast<size_t>(maxBatch), 3,
+                                  static_cast<size_t>(size.height), static_cast<size_t>(size.width)}});
+        for (auto &&name : outputNames) {
+            network.outputs.push_back({name, Precision::FP32, {static_cast<size_t>(maxBatch), 1}});
+        }
+        return network;
+    }
+};
+
+struct AgeGenderDetection : AttributeNetwork {
+    std::string outputAge;
+    std::string outputGender;
+
+    using BaseDetection::operator=;
+    explicit AgeGenderDetection(const std::string &modelPath = FLAGS_m_ag, const std::string &deviceName = FLAGS_d_ag,
+                                int maxBatch = FLAGS_n_ag)
+        : AttributeNetwork(modelPath, deviceName, "Age Gender", maxBatch) {}
+
+    void parse(int idx, FaceRecord &face) const override {
+        auto  genderBlob = request->getBlob(outputGender);
+        auto  ageBlob    = request->getBlob(outputAge);
+
+        face.hasAgeGender = true;
+        face.age = ageBlob->buffer().as<float*>()[idx] * 100;
+        face.maleProb = genderBlob->buffer().as<float*>()[idx * 2 + 1];
+    }
+
+    std::unique_ptr<AttributeNetwork> clone() const override {
+        return std::unique_ptr<AttributeNetwork>(new AgeGenderDetection(*this));
+    }
+
+    /** Ages between 15 and 70 years, male probabilities spread over 0..1 **/
+    StubNetwork describeStub() override {
+        outputAge = "age_conv3";
+        outputGender = "prob";
+        StubNetwork network = stubNetwork("ag", cv::Size(62, 62), {outputAge});
+        network.outputs.push_back({outputGender, Precision::FP32, {static_cast<size_t>(maxBatch), 2, 1, 1}});
+        const std::string age = outputAge, gender = outputGender;
+        network.fill = [age, gender](std::mt19937 &rng, int items, size_t, StubNetwork::BlobMap &outputs) {
+            float *ages = outputs[age]->buffer().as<float *>();
+            float *genders = outputs[gender]->buffer().as<float *>();
+            std::uniform_real_distribution<float> ageDistribution(0.15f, 0.7f), maleProb(0.f, 1.f);
+            for (int i = 0; i < items; i++) {
+                ages[i] = ageDistribution(rng);
+                genders[i * 2 + 1] = maleProb(rng);
+                genders[i * 2] = 1 - genders[i * 2 + 1];
+            }
+        };
+        return network;
+    }
+
+protected:
+    /** Age Gender network should have two outputs **/
+    void checkOutputs(InferenceEngine::OutputsDataMap &outputInfo) override {
         if (outputInfo.size() != 2) {
             throw std::logic_error("Age Gender network should have two output layers");
         }
@@ -390,45 +695,17 @@ struct AgeGenderDetection : BaseDetection {
 
         outputAge = ageOutput->name;
         outputGender = genderOutput->name;
-
-        slog::info << "Loading Age Gender model to the "<< FLAGS_d_ag << " plugin" << slog::endl;
-        _enabled = true;
-        return netReader.getNetwork();
     }
 };
 
-struct HeadPoseDetection : BaseDetection {
-    std::string input;
+struct HeadPoseDetection : AttributeNetwork {
     std::string outputAngleR = "angle_r_fc";
     std::string outputAngleP = "angle_p_fc";
     std::string outputAngleY = "angle_y_fc";
-    int enquedFaces = 0;
     cv::Mat cameraMatrix;
-    HeadPoseDetection() : BaseDetection(FLAGS_m_hp, "Head Pose", FLAGS_n_hp) {}
-
-    void submitRequest() override {
-        if (!enquedFaces) return;
-        BaseDetection::submitRequest();
-        enquedFaces = 0;
-    }
-
-    void enqueue(const cv::Mat &face) {
-        if (!enabled()) {
-            return;
-        }
-        if (enquedFaces == maxBatch) {
-            slog::warn << "Number of detected faces more than maximum(" << maxBatch << ") processed by Head Pose detector" << slog::endl;
-            return;
-        }
-        if (!request) {
-            request = net.CreateInferRequestPtr();
-        }
-
-        auto  inputBlob = request->GetBlob(input);
-
-        matU8ToBlob<float>(face, inputBlob, enquedFaces);
-        enquedFaces++;
-    }
+    explicit HeadPoseDetection(const std::string &modelPath = FLAGS_m_hp, const std::string &deviceName = FLAGS_d_hp,
+                               int maxBatch = FLAGS_n_hp)
+        : AttributeNetwork(modelPath, deviceName, "Head Pose", maxBatch) {}
 
     struct Results {
         float angle_r;
@@ -436,45 +713,39 @@ struct HeadPoseDetection : BaseDetection {
         float angle_y;
     };
 
-    Results operator[] (int idx) const {
-        auto  angleR = request->GetBlob(outputAngleR);
-        auto  angleP = request->GetBlob(outputAngleP);
-        auto  angleY = request->GetBlob(outputAngleY);
+    void parse(int idx, FaceRecord &face) const override {
+        auto  angleR = request->getBlob(outputAngleR);
+        auto  angleP = request->getBlob(outputAngleP);
+        auto  angleY = request->getBlob(outputAngleY);
 
-        return {angleR->buffer().as<float*>()[idx],
-                angleP->buffer().as<float*>()[idx],
-                angleY->buffer().as<float*>()[idx]};
+        face.hasHeadPose = true;
+        face.roll = angleR->buffer().as<float*>()[idx];
+        face.pitch = angleP->buffer().as<float*>()[idx];
+        face.yaw = angleY->buffer().as<float*>()[idx];
     }
 
-    CNNNetwork read() override {
-        slog::info << "Loading network files for Head Pose detection " << slog::endl;
-        InferenceEngine::CNNNetReader netReader;
-        /** Read network model **/
-        netReader.ReadNetwork(FLAGS_m_hp);
-        /** Set batch size to maximum currently set to one provided from command line **/
-        netReader.getNetwork().setBatchSize(maxBatch);
-        netReader.getNetwork().setBatchSize(maxBatch);
-        slog::info << "Batch size is set to  " << netReader.getNetwork().getBatchSize() << " for Head Pose Network" << slog::endl;
-        /** Extract model name and load it's weights **/
-        std::string binFileName = fileNameNoExt(FLAGS_m_hp) + ".bin";
-        netReader.ReadWeights(binFileName);
-
+    std::unique_ptr<AttributeNetwork> clone() const override {
+        return std::unique_ptr<AttributeNetwork>(new HeadPoseDetection(*this));
+    }
 
-        // ---------------------------Check inputs ------------------------------------------------------
-        slog::info << "Checking Head Pose Network inputs" << slog::endl;
-        InferenceEngine::InputsDataMap inputInfo(netReader.getNetwork().getInputsInfo());
-        if (inputInfo.size() != 1) {
-            throw std::logic_error("Head Pose topology should have only one input");
-        }
-        auto& inputInfoFirst = inputInfo.begin()->second;
-        inputInfoFirst->setPrecision(Precision::FP32);
-        inputInfoFirst->getInputData()->setLayout(Layout::NCHW);
-        input = inputInfo.begin()->first;
-        // -----------------------------------------------------------------------------------------------------
+    /** Normally distributed angles, mostly looking towards the camera **/
+    StubNetwork describeStub() override {
+        StubNetwork network = stubNetwork("hp", cv::Size(60, 60), {outputAngleR, outputAngleP, outputAngleY});
+        const std::string r = outputAngleR, p = outputAngleP, y = outputAngleY;
+        network.fill = [r, p, y](std::mt19937 &rng, int items, size_t, StubNetwork::BlobMap &outputs) {
+            std::normal_distribution<float> roll(0.f, 8.f), pitch(0.f, 10.f), yaw(0.f, 20.f);
+            for (int i = 0; i < items; i++) {
+                outputs[r]->buffer().as<float *>()[i] = roll(rng);
+                outputs[p]->buffer().as<float *>()[i] = pitch(rng);
+                outputs[y]->buffer().as<float *>()[i] = yaw(rng);
+            }
+        };
+        return network;
+    }
 
-        // ---------------------------Check outputs ------------------------------------------------------
-        slog::info << "Checking Head Pose network outputs" << slog::endl;
-        InferenceEngine::OutputsDataMap outputInfo(netReader.getNetwork().getOutputsInfo());
+protected:
+    /** Head Pose network should have three single value FullyConnected outputs **/
+    void checkOutputs(InferenceEngine::OutputsDataMap &outputInfo) override {
         if (outputInfo.size() != 3) {
             throw std::logic_error("Head Pose network should have 3 outputs");
         }
@@ -501,169 +772,1296 @@ struct HeadPoseDetection : BaseDetection {
             }
             layerNames[layer->name] = true;
         }
-
-        slog::info << "Loading Head Pose model to the "<< FLAGS_d_hp << " plugin" << slog::endl;
-
-        _enabled = true;
-        return netReader.getNetwork();
     }
 
+public:
     void buildCameraMatrix(int cx, int cy, float focalLength) {
         if (!cameraMatrix.empty()) return;
-        cameraMatrix = cv::Mat::zeros(3, 3, CV_32F);
-        cameraMatrix.at<float>(0) = focalLength;
-        cameraMatrix.at<float>(2) = static_cast<float>(cx);
-        cameraMatrix.at<float>(4) = focalLength;
-        cameraMatrix.at<float>(5) = static_cast<float>(cy);
-        cameraMatrix.at<float>(8) = 1;
+        cameraMatrix = makeCameraMatrix(cx, cy, focalLength);
     }
 
     void drawAxes(cv::Mat& frame, cv::Point3f cpoint, Results headPose, float scale) {
-        double yaw   = headPose.angle_y;
-        double pitch = headPose.angle_p;
-        double roll  = headPose.angle_r;
-
-        if (FLAGS_r) {
-            std::cout << "Head pose results: yaw, pitch, roll = " << yaw << ";" << pitch << ";" << roll << std::endl;
-        }
-
-        pitch *= CV_PI / 180.0;
-        yaw   *= CV_PI / 180.0;
-        roll  *= CV_PI / 180.0;
-
-        cv::Matx33f        Rx(1,           0,            0,
-                              0,  cos(pitch),  -sin(pitch),
-                              0,  sin(pitch),  cos(pitch));
-        cv::Matx33f Ry(cos(yaw),           0,    -sin(yaw),
-                              0,           1,            0,
-                       sin(yaw),           0,    cos(yaw));
-        cv::Matx33f Rz(cos(roll), -sin(roll),            0,
-                       sin(roll),  cos(roll),            0,
-                              0,           0,            1);
-
-
-        auto r = cv::Mat(Rz*Ry*Rx);
         buildCameraMatrix(frame.cols / 2, frame.rows / 2, 950.0);
+        drawHeadPoseAxes(frame, cpoint, headPose.angle_y, headPose.angle_p, headPose.angle_r, scale, cameraMatrix);
+    }
+};
 
-        cv::Mat xAxis(3, 1, CV_32F), yAxis(3, 1, CV_32F), zAxis(3, 1, CV_32F), zAxis1(3, 1, CV_32F);
-
-        xAxis.at<float>(0) = 1 * scale;
-        xAxis.at<float>(1) = 0;
-        xAxis.at<float>(2) = 0;
-
-        yAxis.at<float>(0) = 0;
-        yAxis.at<float>(1) = -1 * scale;
-        yAxis.at<float>(2) = 0;
-
-        zAxis.at<float>(0) = 0;
-        zAxis.at<float>(1) = 0;
-        zAxis.at<float>(2) = -1 * scale;
-
-        zAxis1.at<float>(0) = 0;
-        zAxis1.at<float>(1) = 0;
-        zAxis1.at<float>(2) = 1 * scale;
-
-        cv::Mat o(3, 1, CV_32F, cv::Scalar(0));
-        o.at<float>(2) = cameraMatrix.at<float>(0);
-
-        xAxis = r * xAxis + o;
-        yAxis = r * yAxis + o;
-        zAxis = r * zAxis + o;
-        zAxis1 = r * zAxis1 + o;
-
-        cv::Point p1, p2;
-
-        p2.x = static_cast<int>((xAxis.at<float>(0) / xAxis.at<float>(2) * cameraMatrix.at<float>(0)) + cpoint.x);
-        p2.y = static_cast<int>((xAxis.at<float>(1) / xAxis.at<float>(2) * cameraMatrix.at<float>(4)) + cpoint.y);
-        cv::line(frame, cv::Point(cpoint.x, cpoint.y), p2, cv::Scalar(0, 0, 255), 2);
-
-        p2.x = static_cast<int>((yAxis.at<float>(0) / yAxis.at<float>(2) * cameraMatrix.at<float>(0)) + cpoint.x);
-        p2.y = static_cast<int>((yAxis.at<float>(1) / yAxis.at<float>(2) * cameraMatrix.at<float>(4)) + cpoint.y);
-        cv::line(frame, cv::Point(cpoint.x, cpoint.y), p2, cv::Scalar(0, 255, 0), 2);
+/**
+* \brief Per-face network registered with -m_attr whose outputs need no interpretation:
+* every output value of a face is reported under the network name, or under name.output
+* when the network has several outputs.
+*/
+struct GenericAttributeNetwork : AttributeNetwork {
+    std::vector<std::pair<std::string, std::string>> outputs;  // output blob name, attribute name
+
+    GenericAttributeNetwork(const std::string &name, const std::string &modelPath, const std::string &deviceName, int maxBatch)
+        : AttributeNetwork(modelPath, deviceName, name, maxBatch) {}
+
+    void parse(int idx, FaceRecord &face) const override {
+        for (auto &&output : outputs) {
+            auto blob = request->getBlob(output.first);
+            const size_t valuesPerFace = blob->size() / maxBatch;
+            const float *values = blob->buffer().as<float*>() + idx * valuesPerFace;
+            face.attributes[output.second].assign(values, values + valuesPerFace);
+        }
+    }
 
-        p1.x = static_cast<int>((zAxis1.at<float>(0) / zAxis1.at<float>(2) * cameraMatrix.at<float>(0)) + cpoint.x);
-        p1.y = static_cast<int>((zAxis1.at<float>(1) / zAxis1.at<float>(2) * cameraMatrix.at<float>(4)) + cpoint.y);
+    std::unique_ptr<AttributeNetwork> clone() const override {
+        return std::unique_ptr<AttributeNetwork>(new GenericAttributeNetwork(*this));
+    }
 
-        p2.x = static_cast<int>((zAxis.at<float>(0) / zAxis.at<float>(2) * cameraMatrix.at<float>(0)) + cpoint.x);
-        p2.y = static_cast<int>((zAxis.at<float>(1) / zAxis.at<float>(2) * cameraMatrix.at<float>(4)) + cpoint.y);
-        cv::line(frame, p1, p2, cv::Scalar(255, 0, 0), 2);
+    /** One value between 0 and 1 per face, the latency is configured under the network name **/
+    StubNetwork describeStub() override {
+        outputs.assign(1, std::make_pair(std::string("output"), topoName));
+        StubNetwork network = stubNetwork(topoName, cv::Size(64, 64), {outputs.front().first});
+        network.fill = [](std::mt19937 &rng, int items, size_t, StubNetwork::BlobMap &outputs) {
+            std::uniform_real_distribution<float> value(0.f, 1.f);
+            for (int i = 0; i < items; i++) {
+                outputs["output"]->buffer().as<float *>()[i] = value(rng);
+            }
+        };
+        return network;
+    }
 
-        cv::circle(frame, p2, 3, cv::Scalar(255, 0, 0), 2);
+protected:
+    void checkOutputs(InferenceEngine::OutputsDataMap &outputInfo) override {
+        outputs.clear();
+        for (auto &&output : outputInfo) {
+            output.second->setPrecision(Precision::FP32);
+            outputs.push_back(std::make_pair(output.first,
+                outputInfo.size() == 1 ? topoName : topoName + "." + output.first));
+            slog::info << topoName << " output: " << output.first << slog::endl;
+        }
     }
 };
 
+/**
+* \brief Creates the networks listed in -m_attr as "<name>,<model>[,<device>[,<batch>]]" entries separated by ';'
+*/
+std::vector<std::unique_ptr<AttributeNetwork>> createAttributeNetworks(const std::string &list) {
+    std::vector<std::unique_ptr<AttributeNetwork>> networks;
+    std::stringstream entries(list);
+    std::string entry;
+    while (std::getline(entries, entry, ';')) {
+        if (entry.empty()) {
+            continue;
+        }
+        std::vector<std::string> fields;
+        std::stringstream fieldStream(entry);
+        std::string field;
+        while (std::getline(fieldStream, field, ',')) {
+            fields.push_back(field);
+        }
+        if (fields.size() < 2 || fields.size() > 4 || fields[0].empty() || fields[1].empty()) {
+            throw std::logic_error("Parameter -m_attr has an invalid entry: " + entry +
+                                   ", should be <name>,<model>[,<device>[,<batch>]]");
+        }
+        int batch = 1;
+        if (fields.size() > 3) {
+            char *end = nullptr;
+            errno = 0;
+            const long value = std::strtol(fields[3].c_str(), &end, 10);
+            if (fields[3].empty() || *end != '\0' || errno == ERANGE || value < 1 || value > INT_MAX) {
+                throw std::logic_error("-m_attr batch of " + fields[0] + " must be a positive integer: " + fields[3]);
+            }
+            batch = static_cast<int>(value);
+        }
+        networks.emplace_back(new GenericAttributeNetwork(fields[0], fields[1],
+                                                          fields.size() > 2 ? fields[2] : "CPU", batch));
+    }
+    return networks;
+}
+
 struct Load {
     BaseDetection& detector;
     explicit Load(BaseDetection& detector) : detector(detector) { }
 
     void into(InferenceEngine::InferencePlugin & plg) const {
         if (detector.enabled()) {
-            detector.net = plg.LoadNetwork(detector.read(), {});
-            detector.plugin = &plg;
+            detector.backend = std::make_shared<IEBackend>(plg.LoadNetwork(detector.read(), {}));
         }
     }
-};
-
-int main(int argc, char *argv[]) {
-    try {
-        /** This sample covers 3 certain topologies and cannot be generalized **/
-        std::cout << "InferenceEngine: " << InferenceEngine::GetInferenceEngineVersion() << std::endl;
 
-        // ---------------------------Parsing and validation of input args--------------------------------------
-        if (!ParseAndCheckCommandLine(argc, argv)) {
-            return 0;
+    /** Loads a stub of the network instead, with the latency configured under its key or its default latency **/
+    void intoStub(const std::map<std::string, LatencyModel> &latencies, uint32_t seed) const {
+        if (detector.enabled()) {
+            const StubNetwork network = detector.describeStub();
+            auto latency = latencies.find(network.key);
+            detector.backend = std::make_shared<StubBackend>(network, latency != latencies.end() ? latency->second :
+                                                             LatencyModel::parse(network.defaultLatency), seed);
         }
+    }
+};
 
-        // -----------------------------Read input -----------------------------------------------------
-        slog::info << "Reading input" << slog::endl;
-        cv::VideoCapture cap;
-        const bool isCamera = FLAGS_i == "cam";
-        if (!(FLAGS_i == "cam" ? cap.open(0) : cap.open(FLAGS_i))) {
-            throw std::logic_error("Cannot open input file or camera: " + FLAGS_i);
+/**
+* \brief Face detection on overlapping tiles of the frame, so small faces keep their size in the detector input.
+* Tiles go through the detector either as one batch or, with concurrent set, as one infer request per tile
+* running at the same time. Detections are mapped back to frame coordinates and merged with NMS across tiles.
+* An optional extra "tile" covering the whole frame catches faces larger than the tile overlap.
+*/
+class TiledFaceDetection {
+public:
+    typedef std::chrono::duration<double, std::ratio<1, 1000>> ms;
+
+    std::vector<cv::Rect> tiles;
+    std::vector<FaceDetectionClass::Result> results;
+
+    /** Tiles for a frame size, the whole frame is appended as the last tile when includeFullFrame is set **/
+    static std::vector<cv::Rect> makeTiles(const cv::Size &frameSize, int cols, int rows, double overlap, bool includeFullFrame) {
+        std::vector<cv::Rect> tiles = tileGrid(frameSize, cols, rows, overlap);
+        if (includeFullFrame) {
+            tiles.push_back(cv::Rect(0, 0, frameSize.width, frameSize.height));
         }
-        const size_t width  = (size_t) cap.get(CV_CAP_PROP_FRAME_WIDTH);
-        const size_t height = (size_t) cap.get(CV_CAP_PROP_FRAME_HEIGHT);
+        return tiles;
+    }
 
-        // read input (video) frame
-        cv::Mat frame;
-        if (!cap.read(frame)) {
-            throw std::logic_error("Failed to get frame from cv::VideoCapture");
+    TiledFaceDetection(FaceDetectionClass &detector, const std::vector<cv::Rect> &tiles, bool concurrent, float nmsThreshold)
+        : tiles(tiles), _detector(detector), _concurrent(concurrent), _nmsThreshold(nmsThreshold),
+          _tileLatencyMs(tiles.size(), 0), _tileMaxLatencyMs(tiles.size(), 0), _completed(tiles.size()) {
+        if (!concurrent && detector.maxBatch < static_cast<int>(tiles.size())) {
+            throw std::logic_error("Face Detection batch is smaller than the number of tiles");
         }
+        if (concurrent) {
+            for (size_t t = 0; t < tiles.size(); t++) {
+                _tileDetectors.push_back(detector);
+                FaceDetectionClass &tileDetector = _tileDetectors.back();
+                tileDetector.request = tileDetector.backend->createRequest();
+                tileDetector.request->setCompletionCallback([this, t] {
+                    std::lock_guard<std::mutex> lock(_completedMutex);
+                    _completed[t] = std::chrono::high_resolution_clock::now();
+                });
+            }
+        }
+    }
 
-        // ---------------------Load plugins for inference engine------------------------------------------------
-        std::map<std::string, InferencePlugin> pluginsForDevices;
-        std::vector<std::pair<std::string, std::string>> cmdOptions = {
-            {FLAGS_d, FLAGS_m}, {FLAGS_d_ag, FLAGS_m_ag}, {FLAGS_d_hp, FLAGS_m_hp}
-        };
+    void detect(const cv::Mat &frame) {
+        results.clear();
+        std::vector<FaceDetectionClass::Result> raw;
+        auto start = std::chrono::high_resolution_clock::now();
+        if (_concurrent) {
+            for (size_t t = 0; t < tiles.size(); t++) {
+                _tileDetectors[t].enqueue(frame(tiles[t]));
+                _tileDetectors[t].submitRequest();
+            }
+            for (size_t t = 0; t < tiles.size(); t++) {
+                _tileDetectors[t].wait();
+                auto waited = std::chrono::high_resolution_clock::now();
+                std::chrono::high_resolution_clock::time_point completed;
+                {
+                    std::lock_guard<std::mutex> lock(_completedMutex);
+                    completed = _completed[t];
+                }
+                // the completion callback may still be running when Wait() returns
+                addTileLatency(t, std::chrono::duration_cast<ms>((completed > start ? completed : waited) - start).count());
+                _tileDetectors[t].fetchResults();
+                appendTileResults(_tileDetectors[t].results, static_cast<int>(t), raw);
+            }
+        } else {
+            for (auto &&tile : tiles) {
+                _detector.enqueue(frame(tile));
+            }
+            _detector.submitRequest();
+            _detector.wait();
+            const double latencyMs = std::chrono::duration_cast<ms>(std::chrono::high_resolution_clock::now() - start).count();
+            for (size_t t = 0; t < tiles.size(); t++) {
+                addTileLatency(t, latencyMs);
+            }
+            _detector.fetchResults();
+            appendTileResults(_detector.results, -1, raw);
+        }
 
-        FaceDetectionClass FaceDetection;
-        AgeGenderDetection AgeGender;
-        HeadPoseDetection HeadPose;
+        std::vector<cv::Rect> boxes;
+        std::vector<float> scores;
+        for (auto &&result : raw) {
+            boxes.push_back(result.location);
+            scores.push_back(result.confidence);
+        }
+        for (size_t index : nonMaximumSuppression(boxes, scores, _nmsThreshold)) {
+            results.push_back(raw[index]);
+        }
+        _frames++;
+        _rawDetections += raw.size();
+        _mergedDetections += results.size();
+    }
 
+    void printStatistics() const {
+        if (_frames == 0) {
+            return;
+        }
+        slog::info << "   Tiled Face Detection: " << tiles.size() << " tiles "
+                   << (_concurrent ? "in concurrent requests" : "in one batch") << ", "
+                   << std::fixed << std::setprecision(2) << static_cast<double>(_rawDetections) / _frames
+                   << " detections per frame before and " << static_cast<double>(_mergedDetections) / _frames
+                   << " after cross-tile NMS" << slog::endl;
+        for (size_t t = 0; t < tiles.size(); t++) {
+            slog::info << "     Tile " << t << " (" << tiles[t].x << "," << tiles[t].y << " " << tiles[t].width << "x"
+                       << tiles[t].height << "): avg latency " << _tileLatencyMs[t] / _frames << " ms, max "
+                       << _tileMaxLatencyMs[t] << " ms" << slog::endl;
+        }
+    }
 
-        for (auto && option : cmdOptions) {
-            auto deviceName = option.first;
-            auto networkName = option.second;
+private:
+    void addTileLatency(size_t tile, double latencyMs) {
+        _tileLatencyMs[tile] += latencyMs;
+        _tileMaxLatencyMs[tile] = std::max(_tileMaxLatencyMs[tile], latencyMs);
+    }
 
-            if (deviceName == "" || networkName == "") {
-                continue;
-            }
+    /** Detections come in tile coordinates, in batch mode (tile < 0) batchIndex tells the tile **/
+    void appendTileResults(const std::vector<FaceDetectionClass::Result> &tileResults, int tile,
+                           std::vector<FaceDetectionClass::Result> &raw) const {
+        for (auto result : tileResults) {
+            const cv::Rect &tileRect = tiles[tile < 0 ? result.batchIndex : tile];
+            result.location += tileRect.tl();
+            result.batchIndex = 0;
+            raw.push_back(result);
+        }
+    }
 
-            if (pluginsForDevices.find(deviceName) != pluginsForDevices.end()) {
-                continue;
-            }
-            slog::info << "Loading plugin " << deviceName << slog::endl;
-            InferencePlugin plugin = PluginDispatcher({"../../../lib/intel64", ""}).getPluginByDevice(deviceName);
+    FaceDetectionClass &_detector;
+    const bool _concurrent;
+    const float _nmsThreshold;
+    std::deque<FaceDetectionClass> _tileDetectors;
 
-            /** Printing plugin version **/
-            printPluginVersion(plugin, std::cout);
+    std::mutex _completedMutex;
+    std::vector<double> _tileLatencyMs;
+    std::vector<double> _tileMaxLatencyMs;
+    std::vector<std::chrono::high_resolution_clock::time_point> _completed;
 
-            /** Load extensions for the CPU plugin **/
-            if ((deviceName.find("CPU") != std::string::npos)) {
-                plugin.AddExtension(std::make_shared<Extensions::Cpu::CpuExtensions>());
+    size_t _frames = 0;
+    size_t _rawDetections = 0;
+    size_t _mergedDetections = 0;
+};
 
-                if (!FLAGS_l.empty()) {
-                    // CPU(MKLDNN) extensions are loaded as a shared library and passed as a pointer to base extension
+/**
+* \brief Applies -fd_reshape: "<W>x<H>" sets the detector input size, a plain number of pixels keeps the
+* aspect ratio of the stream (or of the IR when there is no single stream, e.g. for directories).
+*/
+void configureDetectorReshape(FaceDetectionClass &detector, const std::string &spec, const cv::Size &streamSize) {
+    if (spec.empty()) {
+        return;
+    }
+    int width = 0, height = 0;
+    char tail = 0;
+    if (std::sscanf(spec.c_str(), "%dx%d%c", &width, &height, &tail) == 2) {
+        if (width < 1 || height < 1) {
+            throw std::logic_error("Parameter -fd_reshape has an invalid size: " + spec);
+        }
+        detector.reshapeSize = cv::Size(width, height);
+        return;
+    }
+    double pixels = 0;
+    if (std::sscanf(spec.c_str(), "%lf%c", &pixels, &tail) != 1 || pixels < 256) {
+        throw std::logic_error("Parameter -fd_reshape should be <width>x<height> or a number of pixels, but was: " + spec);
+    }
+    detector.reshapePixels = pixels;
+    if (streamSize.area() > 0) {
+        detector.reshapeAspect = static_cast<double>(streamSize.width) / streamSize.height;
+    }
+}
+
+/**
+* \brief Prints the accumulated per-layer counters of all networks and exports them with -pc_out
+*/
+void reportPerformanceCounts(const std::vector<BaseDetection *> &detectors) {
+    for (auto &&detector : detectors) {
+        detector->printPerformanceCounts();
+    }
+    if (FLAGS_pc_out.empty()) {
+        return;
+    }
+    std::ofstream csv(FLAGS_pc_out + ".csv");
+    std::ofstream json(FLAGS_pc_out + ".json");
+    if (!csv || !json) {
+        throw std::logic_error("Cannot write performance counters to " + FLAGS_pc_out + ".csv/.json");
+    }
+    csv << PerfCounterAggregator::csvHeader() << '\n';
+    json << "{";
+    bool first = true;
+    for (auto &&detector : detectors) {
+        if (!detector->enabled()) {
+            continue;
+        }
+        detector->perfCounters->writeCsv(csv, detector->topoName);
+        json << (first ? "" : ",") << "\n  \"" << detector->topoName << "\": ";
+        detector->perfCounters->writeJson(json);
+        first = false;
+    }
+    json << "\n}\n";
+    slog::info << "Performance counters written to " << FLAGS_pc_out << ".csv and " << FLAGS_pc_out << ".json" << slog::endl;
+}
+
+/**
+* \brief End of every processing mode, after the mode printed its own statistics: the CPU cost of the frames
+* accounted in cpu (nothing for 0 frames), the input statistics of the second stage, the writers, which are
+* closed first, and the performance counters.
+*/
+void finishRun(const std::vector<BaseDetection *> &allNetworks, const std::vector<AttributeNetwork *> &attributeNetworks,
+               AsyncFrameWriter *outputWriter, ResultsWriter *resultsWriter, CpuAccounting &cpu, size_t frames,
+               double streamFps) {
+    std::string nb(80, '-');
+    cpu.stop();
+    if (frames > 0) {
+        cpu.print(frames, streamFps);
+        std::cout << nb << std::endl;
+    }
+    if (!attributeNetworks.empty()) {
+        for (auto &&network : attributeNetworks) {
+            network->printInputStatistics();
+        }
+        std::cout << nb << std::endl;
+    }
+    if (outputWriter) {
+        outputWriter->close();
+        outputWriter->printStatistics();
+        std::cout << nb << std::endl;
+    }
+    if (resultsWriter) {
+        resultsWriter->close();
+        resultsWriter->printStatistics();
+        std::cout << nb << std::endl;
+    }
+    if (FLAGS_pc) {
+        reportPerformanceCounts(allNetworks);
+    }
+    slog::info << "Execution successful" << slog::endl;
+}
+
+/**
+* \brief Runs every registered second stage network on all face crops. The batches of all networks
+* are submitted together, so one round trip costs as much as the slowest network instead of their sum.
+* Crops are resized once per input size that several networks share. Results are parsed into faces,
+* which must hold one record per crop. Returns the time spent in second stage inference, in milliseconds.
+*/
+double inferFaceAttributes(const std::vector<cv::Mat> &faces, const std::vector<AttributeNetwork *> &networks,
+                           std::vector<FaceRecord> &records) {
+    typedef std::chrono::duration<double, std::ratio<1, 1000>> ms;
+    double inferenceTime = 0;
+    if (faces.empty() || networks.empty()) {
+        return inferenceTime;
+    }
+
+    // shared preprocessing, matU8ToBlob skips its own resize for crops that already have the input size
+    std::map<std::pair<int, int>, int> networksPerSize;
+    for (auto &&network : networks) {
+        networksPerSize[std::make_pair(network->inputSize.width, network->inputSize.height)]++;
+    }
+    std::map<std::pair<int, int>, std::vector<cv::Mat>> resizedFaces;
+    for (auto &&size : networksPerSize) {
+        if (size.second < 2 || size.first.first <= 0 || size.first.second <= 0) {
+            continue;
+        }
+        std::vector<cv::Mat> &resized = resizedFaces[size.first];
+        resized.resize(faces.size());
+        for (size_t i = 0; i < faces.size(); i++) {
+            cv::resize(faces[i], resized[i], cv::Size(size.first.first, size.first.second));
+        }
+    }
+    std::vector<const std::vector<cv::Mat> *> inputs;
+    for (auto &&network : networks) {
+        auto resized = resizedFaces.find(std::make_pair(network->inputSize.width, network->inputSize.height));
+        inputs.push_back(resized == resizedFaces.end() ? &faces : &resized->second);
+    }
+
+    std::vector<size_t> nextFace(networks.size(), 0);
+    std::vector<int> batch(networks.size(), 0);
+    bool pending = true;
+    while (pending) {
+        // enqueue input batch
+        for (size_t n = 0; n < networks.size(); n++) {
+            batch[n] = 0;
+            while (nextFace[n] < faces.size() && networks[n]->enquedFaces < networks[n]->maxBatch) {
+                networks[n]->enqueue((*inputs[n])[nextFace[n]++]);
+                batch[n]++;
+            }
+        }
+
+        auto t0 = std::chrono::high_resolution_clock::now();
+        // all requests run at the same time, submitting is a no-op when nothing was enqueued
+        for (auto &&network : networks) {
+            network->submitRequest();
+        }
+        for (size_t n = 0; n < networks.size(); n++) {
+            if (batch[n] > 0) {
+                networks[n]->wait();
+            }
+        }
+        auto t1 = std::chrono::high_resolution_clock::now();
+        inferenceTime += std::chrono::duration_cast<ms>(t1 - t0).count();
+
+        pending = false;
+        for (size_t n = 0; n < networks.size(); n++) {
+            const size_t first = nextFace[n] - batch[n];
+            for (int ri = 0; ri < batch[n]; ri++) {
+                networks[n]->parse(ri, records[first + ri]);
+            }
+            pending = pending || nextFace[n] < faces.size();
+        }
+    }
+    return inferenceTime;
+}
+
+FaceRecord makeFaceRecord(const FaceDetectionClass::Result &faceResult) {
+    FaceRecord face;
+    face.location = faceResult.location;
+    face.confidence = faceResult.confidence;
+    face.label = faceResult.label;
+    return face;
+}
+
+/**
+* \brief Runs variant A and variant B of the networks over the same frames, one after the other so their
+* timings do not interfere, and reports the speedup and drift of B. Attributes of both variants are
+* computed on the crops of the A detections, so attribute drift does not mix with detection drift.
+* Networks without a B variant are not compared.
+*/
+void runPrecisionComparison(const std::function<bool(cv::Mat &)> &nextFrame, size_t maxFrames,
+                            FaceDetectionClass &detectorA, FaceDetectionClass *detectorB,
+                            const std::vector<std::pair<AttributeNetwork *, AttributeNetwork *>> &attributePairs) {
+    typedef std::chrono::duration<double, std::ratio<1, 1000>> ms;
+    PrecisionComparison comparison;
+
+    auto detect = [](FaceDetectionClass &detector, const cv::Mat &frame, std::vector<FaceRecord> &records) {
+        auto t0 = std::chrono::high_resolution_clock::now();
+        detector.enqueue(frame);
+        detector.submitRequest();
+        detector.wait();
+        auto t1 = std::chrono::high_resolution_clock::now();
+        detector.fetchResults();
+        for (auto &&result : detector.results) {
+            records.push_back(makeFaceRecord(result));
+        }
+        return std::chrono::duration_cast<ms>(t1 - t0).count();
+    };
+
+    size_t frames = 0;
+    cv::Mat frame;
+    while ((maxFrames == 0 || frames < maxFrames) && nextFrame(frame)) {
+        std::vector<FaceRecord> facesA, facesB;
+        const double detectMsA = detect(detectorA, frame, facesA);
+        if (detectorB) {
+            const double detectMsB = detect(*detectorB, frame, facesB);
+            comparison.addDetections(facesA, facesB);
+            if (frames > 0) {  // the first inference includes one-time initialization
+                comparison.addTiming(detectorA.topoName, detectMsA, detectMsB);
+            }
+        }
+
+        std::vector<cv::Mat> crops;
+        for (auto &&face : facesA) {
+            crops.push_back(cropFace(frame, face.location));
+        }
+        for (auto &&networks : attributePairs) {
+            std::vector<FaceRecord> attributesA = facesA, attributesB = facesA;
+            const double msA = inferFaceAttributes(crops, {networks.first}, attributesA);
+            const double msB = inferFaceAttributes(crops, {networks.second}, attributesB);
+            if (frames > 0 && !crops.empty()) {
+                comparison.addTiming(networks.first->topoName, msA, msB);
+            }
+            for (size_t i = 0; i < crops.size(); i++) {
+                comparison.addAttributes(attributesA[i], attributesB[i]);
+            }
+        }
+        frames++;
+    }
+
+    std::string nb(80, '-');
+    std::cout << nb << std::endl;
+    slog::info << "   Compared " << frames << " frames" << slog::endl;
+    comparison.print();
+    std::cout << nb << std::endl;
+}
+
+/**
+* \brief Processes every image of a directory: images are decoded on a worker pool and go through
+* face detection in batches of up to -n_fd images, the faces of a whole batch share the second stage batches.
+* Returns the number of processed images.
+*/
+size_t processImageDirectory(const std::string &directory, FaceDetectionClass &FaceDetection,
+                           const std::vector<AttributeNetwork *> &attributeNetworks, ResultsWriter *resultsWriter) {
+    typedef std::chrono::duration<double, std::ratio<1, 1000>> ms;
+
+    const std::vector<std::string> files = listImageFiles(directory);
+    if (files.empty()) {
+        throw std::logic_error("No images found in directory: " + directory);
+    }
+    const size_t decodeThreads = FLAGS_n_dec ? FLAGS_n_dec : std::max(1u, std::thread::hardware_concurrency());
+    slog::info << "Found " << files.size() << " images, decoding on " << decodeThreads << " threads" << slog::endl;
+
+    auto wallclockStart = std::chrono::high_resolution_clock::now();
+    ParallelImageDecoder decoder(files, decodeThreads, 2 * FaceDetection.maxBatch + decodeThreads);
+
+    size_t totalImages = 0, totalFaces = 0, totalBatches = 0;
+    double detectionTime = 0, secondDetectionTime = 0;
+    std::vector<DecodedImage> batch;
+    DecodedImage image;
+    while (true) {
+        batch.clear();
+        while (batch.size() < static_cast<size_t>(FaceDetection.maxBatch) && decoder.next(image)) {
+            batch.push_back(std::move(image));
+        }
+        if (batch.empty()) {
+            break;
+        }
+
+        auto t0 = std::chrono::high_resolution_clock::now();
+        for (auto &&decoded : batch) {
+            FaceDetection.enqueue(decoded.image);
+        }
+        FaceDetection.submitRequest();
+        FaceDetection.wait();
+        auto t1 = std::chrono::high_resolution_clock::now();
+        detectionTime += std::chrono::duration_cast<ms>(t1 - t0).count();
+        FaceDetection.fetchResults();
+
+        std::vector<cv::Mat> faces;
+        std::vector<FaceRecord> faceRecords;
+        for (auto &&faceResult : FaceDetection.results) {
+            const cv::Mat &source = batch[faceResult.batchIndex].image;
+            faces.push_back(cropFace(source, faceResult.location));
+            faceRecords.push_back(makeFaceRecord(faceResult));
+        }
+        secondDetectionTime += inferFaceAttributes(faces, attributeNetworks, faceRecords);
+
+        std::vector<FrameRecord> records(batch.size());
+        for (size_t bi = 0; bi < batch.size(); bi++) {
+            records[bi].frameIndex = batch[bi].index;
+            records[bi].source = batch[bi].path;
+        }
+        for (size_t ri = 0; ri < FaceDetection.results.size(); ri++) {
+            records[FaceDetection.results[ri].batchIndex].faces.push_back(std::move(faceRecords[ri]));
+        }
+        for (auto &&record : records) {
+            if (FLAGS_r) {
+                std::cout << record.source << ": " << record.faces.size() << " faces" << '\n';
+            }
+            if (resultsWriter) {
+                resultsWriter->push(std::move(record));
+            }
+        }
+
+        totalImages += batch.size();
+        totalFaces += FaceDetection.results.size();
+        totalBatches++;
+    }
+    ms totalTime = std::chrono::duration_cast<ms>(std::chrono::high_resolution_clock::now() - wallclockStart);
+
+    std::string nb(80, '-');
+    std::cout << nb << std::endl;
+    slog::info << "   Total images: " << totalImages << " (" << decoder.failed() << " could not be decoded), "
+               << totalFaces << " faces" << slog::endl;
+    slog::info << "   Total time: " << std::fixed << std::setprecision(2) << totalTime.count() << " ms ("
+               << 1000.0 * totalImages / totalTime.count() << " images per second)" << slog::endl;
+    if (totalImages > 0) {
+        slog::info << "     Avg decode time per image (" << decodeThreads << " threads): " << std::fixed
+                   << std::setprecision(2) << decoder.decodeTimeMs() / totalImages << " ms" << slog::endl;
+        slog::info << "     Avg Face Detection time per batch of " << FaceDetection.maxBatch << ": "
+                   << detectionTime / totalBatches << " ms" << slog::endl;
+        slog::info << "     Avg second stage time per image: " << secondDetectionTime / totalImages
+                   << " ms" << slog::endl;
+    }
+    std::cout << nb << std::endl;
+    return totalImages;
+}
+
+/**
+* \brief Offline processing of a long video file. The file is split into keyframe aligned segments
+* (see planSegments) that the workers take one after the other, so a worker that gets slow segments
+* simply takes fewer of them. Every worker decodes with its own cv::VideoCapture and runs its own
+* infer requests of all networks. Records are merged back in frame order before they are written.
+* The CPU time of the run goes to cpu, returns the number of processed frames.
+*/
+size_t processVideoSegments(const std::string &path, FaceDetectionClass &FaceDetection,
+                            const std::vector<AttributeNetwork *> &attributeNetworks, ResultsWriter *resultsWriter,
+                            size_t workerCount, size_t frameStride, CpuAccounting &cpu) {
+    typedef std::chrono::duration<double, std::ratio<1, 1000>> ms;
+    const size_t segmentsPerWorker = 4;
+
+    VideoCaptureSource probe(path);
+    const int64_t frameCount = probe.frameCount();
+    if (frameCount <= 0) {
+        throw std::logic_error("Cannot split " + path + " into segments, its number of frames is unknown");
+    }
+    const std::vector<VideoSegment> segments = planSegments(frameCount, workerCount * segmentsPerWorker, FLAGS_seg_gop);
+    slog::info << "Processing " << frameCount << " frames in " << segments.size() << " segments on "
+               << workerCount << " workers" << slog::endl;
+
+    struct Worker {
+        FaceDetectionClass detector;
+        std::vector<std::unique_ptr<AttributeNetwork>> networks;
+        size_t segments = 0;
+        size_t frames = 0;
+        size_t faces = 0;
+        double busyMs = 0;
+        double decodeMs = 0;
+        double detectionMs = 0;
+        double secondStageMs = 0;
+
+        explicit Worker(const FaceDetectionClass &detector) : detector(detector) {}
+    };
+    // requests are created up front, creating them from several threads at once is not safe
+    std::vector<std::unique_ptr<Worker>> workers;
+    for (size_t w = 0; w < workerCount; w++) {
+        workers.emplace_back(new Worker(FaceDetection));
+        workers.back()->detector.request = FaceDetection.backend->createRequest();
+        for (auto &&network : attributeNetworks) {
+            workers.back()->networks.push_back(network->clone());
+            workers.back()->networks.back()->request = network->backend->createRequest();
+        }
+    }
+
+    OrderedSegmentMerger merger(segments.size(), [&](FrameRecord &&record) {
+        if (FLAGS_r) {
+            std::cout << "Frame " << record.frameIndex << ": " << record.faces.size() << " faces" << '\n';
+        }
+        if (resultsWriter) {
+            resultsWriter->push(std::move(record));
+        }
+    });
+
+    std::atomic<size_t> nextSegment(0);
+    std::mutex errorMutex;
+    std::exception_ptr error;
+    auto run = [&](Worker &worker) {
+        try {
+            VideoCaptureSource source(path);
+            std::vector<AttributeNetwork *> networks;
+            for (auto &&network : worker.networks) {
+                networks.push_back(network.get());
+            }
+            size_t s;
+            while ((s = nextSegment++) < segments.size()) {
+                auto segmentStart = std::chrono::high_resolution_clock::now();
+                const VideoSegment &segment = segments[s];
+                if (!source.seek(segment.begin)) {
+                    throw std::logic_error("Cannot seek to frame " + std::to_string(segment.begin) + " of " + path);
+                }
+                std::vector<FrameRecord> records;
+                cv::Mat frame;
+                for (int64_t index = segment.begin; index < segment.end; index++) {
+                    auto t0 = std::chrono::high_resolution_clock::now();
+                    if (index % static_cast<int64_t>(frameStride) != 0) {
+                        // skipped frames are only demuxed and decoded, never converted to BGR
+                        if (!source.grab()) {
+                            break;
+                        }
+                        worker.decodeMs += std::chrono::duration_cast<ms>(std::chrono::high_resolution_clock::now() - t0).count();
+                        continue;
+                    }
+                    if (!source.read(frame)) {
+                        break;  // the container reported more frames than it holds
+                    }
+                    FrameRecord record;
+                    record.frameIndex = index;
+                    record.timestampMs = source.timestampMs();
+                    auto t1 = std::chrono::high_resolution_clock::now();
+                    worker.detector.enqueue(frame);
+                    worker.detector.submitRequest();
+                    worker.detector.wait();
+                    auto t2 = std::chrono::high_resolution_clock::now();
+                    worker.decodeMs += std::chrono::duration_cast<ms>(t1 - t0).count();
+                    worker.detectionMs += std::chrono::duration_cast<ms>(t2 - t1).count();
+                    worker.detector.fetchResults();
+
+                    std::vector<cv::Mat> faces;
+                    for (auto &&faceResult : worker.detector.results) {
+                        faces.push_back(cropFace(frame, faceResult.location));
+                        record.faces.push_back(makeFaceRecord(faceResult));
+                    }
+                    worker.secondStageMs += inferFaceAttributes(faces, networks, record.faces);
+                    worker.faces += faces.size();
+                    records.push_back(std::move(record));
+                }
+                worker.frames += records.size();
+                worker.segments++;
+                worker.busyMs += std::chrono::duration_cast<ms>(std::chrono::high_resolution_clock::now() - segmentStart).count();
+                merger.complete(s, std::move(records));
+            }
+        } catch (...) {
+            std::lock_guard<std::mutex> lock(errorMutex);
+            if (!error) {
+                error = std::current_exception();
+            }
+            nextSegment = segments.size();  // the other workers stop after their current segment
+        }
+    };
+
+    cpu.start();
+    auto wallclockStart = std::chrono::high_resolution_clock::now();
+    std::vector<std::thread> threads;
+    for (auto &&worker : workers) {
+        threads.emplace_back(run, std::ref(*worker));
+    }
+    for (auto &&thread : threads) {
+        thread.join();
+    }
+    if (error) {
+        std::rethrow_exception(error);
+    }
+    ms totalTime = std::chrono::duration_cast<ms>(std::chrono::high_resolution_clock::now() - wallclockStart);
+    cpu.stop();
+
+    size_t totalFrames = 0, totalFaces = 0;
+    double totalBusyMs = 0, maxBusyMs = 0;
+    for (auto &&worker : workers) {
+        totalFrames += worker->frames;
+        totalFaces += worker->faces;
+        totalBusyMs += worker->busyMs;
+        maxBusyMs = std::max(maxBusyMs, worker->busyMs);
+    }
+
+    std::string nb(80, '-');
+    std::cout << nb << std::endl;
+    slog::info << "   Total frames: " << totalFrames << ", " << totalFaces << " faces" << slog::endl;
+    slog::info << "   Total time: " << std::fixed << std::setprecision(2) << totalTime.count() << " ms ("
+               << 1000.0 * totalFrames / totalTime.count() << " fps on " << workerCount << " workers)" << slog::endl;
+    for (size_t w = 0; w < workers.size(); w++) {
+        const Worker &worker = *workers[w];
+        if (worker.frames == 0) {
+            slog::info << "     Worker " << w << ": no frames" << slog::endl;
+            continue;
+        }
+        slog::info << "     Worker " << w << ": " << worker.segments << " segments, " << worker.frames << " frames, "
+                   << 1000.0 * worker.frames / worker.busyMs << " fps while busy; per frame decode "
+                   << worker.decodeMs / worker.frames << " ms, detection " << worker.detectionMs / worker.frames
+                   << " ms, second stage " << worker.secondStageMs / worker.frames << " ms" << slog::endl;
+    }
+    if (totalBusyMs > 0) {
+        // 0% when all workers were busy equally long, the run takes as long as the busiest worker
+        slog::info << "     Load imbalance: " << 100.0 * (maxBusyMs / (totalBusyMs / workers.size()) - 1)
+                   << "% (busiest worker " << maxBusyMs << " ms, mean " << totalBusyMs / workers.size() << " ms)" << slog::endl;
+    }
+    slog::info << "     Segments held back for in-order output: at most " << merger.maxPending() << slog::endl;
+    std::cout << nb << std::endl;
+    return totalFrames;
+}
+
+/**
+* \brief Runs the second stage networks on the detections of a cache instead of decoding the video and
+* running Face Detection. Cached crops are used in place; without them the frames of the cached indices
+* are decoded from source and cropped. sourceFrameIndex is the index of the frame already in frame, -1 if
+* nothing was read yet. The CPU time of the replay goes to cpu.
+*/
+void replayDetectionCache(const DetectionCache &cache, FrameSource &source, cv::Mat &frame, int64_t sourceFrameIndex,
+                          const std::vector<AttributeNetwork *> &attributeNetworks, ResultsWriter *resultsWriter,
+                          CpuAccounting &cpu) {
+    typedef std::chrono::duration<double, std::ratio<1, 1000>> ms;
+    slog::info << "Replaying " << cache.frameCount() << " frames from the detection cache "
+               << (cache.hasCrops() ? "with crops, decode and Face Detection are skipped" :
+                                      "without crops, Face Detection is skipped") << slog::endl;
+
+    cpu.start();
+    auto wallclockStart = std::chrono::high_resolution_clock::now();
+    size_t totalFaces = 0;
+    double decodeTime = 0, secondStageTime = 0;
+    for (size_t fi = 0; fi < cache.frameCount(); fi++) {
+        const DetectionCacheFrame &cached = cache.frame(fi);
+        if (!cache.hasCrops() && cached.frameIndex > sourceFrameIndex) {
+            auto t0 = std::chrono::high_resolution_clock::now();
+            bool grabbed = true;
+            while (sourceFrameIndex < cached.frameIndex && (grabbed = source.grab())) {
+                sourceFrameIndex++;
+            }
+            if (!grabbed || !source.retrieve(frame)) {
+                throw std::logic_error("The video ends before frame " + std::to_string(cached.frameIndex) +
+                                       " of the detection cache");
+            }
+            decodeTime += std::chrono::duration_cast<ms>(std::chrono::high_resolution_clock::now() - t0).count();
+        }
+        cpu.lap(cache.hasCrops() ? "cache" : "source");
+
+        std::vector<cv::Mat> faces;
+        FrameRecord record;
+        record.frameIndex = cached.frameIndex;
+        record.timestampMs = cached.timestampMs;
+        for (size_t i = 0; i < cached.faceCount; i++) {
+            const DetectionCacheFace &face = cache.face(cached.firstFace + i);
+            faces.push_back(cache.hasCrops() ? cache.crop(face) : cropFace(frame, cv::Rect(face.x, face.y, face.width, face.height)));
+            record.faces.push_back(makeFaceRecord(DetectionCache::result(face)));
+        }
+        secondStageTime += inferFaceAttributes(faces, attributeNetworks, record.faces);
+        totalFaces += faces.size();
+        cpu.lap("second stage");
+
+        if (resultsWriter) {
+            resultsWriter->push(std::move(record));
+        }
+        cpu.lap("render/output");
+    }
+    ms totalTime = std::chrono::duration_cast<ms>(std::chrono::high_resolution_clock::now() - wallclockStart);
+    cpu.stop();
+
+    const size_t totalFrames = cache.frameCount();
+    std::string nb(80, '-');
+    std::cout << nb << std::endl;
+    slog::info << "   Replayed frames: " << totalFrames << ", " << totalFaces << " faces from "
+               << cache.sizeBytes() / 1024 << " KB of cached detections" << slog::endl;
+    slog::info << "   Total time: " << std::fixed << std::setprecision(2) << totalTime.count() << " ms ("
+               << (totalTime.count() > 0 ? 1000.0 * totalFrames / totalTime.count() : 0.0) << " fps)" << slog::endl;
+    if (totalFrames > 0) {
+        if (!cache.hasCrops()) {
+            slog::info << "     Avg decode time per frame: " << decodeTime / totalFrames << " ms" << slog::endl;
+        }
+        slog::info << "     Avg second stage time per frame: " << secondStageTime / totalFrames << " ms" << slog::endl;
+    }
+    std::cout << nb << std::endl;
+}
+
+/**
+* \brief All faces of one frame or client request waiting for their second stage results.
+* records holds one entry per face, the future becomes ready once every face went through all networks.
+*/
+struct AttributeJob {
+    typedef std::shared_ptr<AttributeJob> Ptr;
+    std::vector<cv::Mat> faces;
+    std::vector<FaceRecord> records;
+
+    std::chrono::high_resolution_clock::time_point enqueued;
+    double batchWaitMs = 0;  // longest time one of the faces waited for its batch
+    double inferenceMs = 0;  // second stage time of all batches the faces went into
+    size_t remaining = 0;
+    std::promise<void> done;
+};
+
+/**
+* \brief Collects face crops of several frames or clients into shared second stage batches.
+* A batch is started as soon as the largest network batch is full or its oldest face waited maxWaitMs,
+* whatever comes first. The networks are only used from the batcher thread.
+*/
+class AttributeBatcher {
+public:
+    AttributeBatcher(const std::vector<AttributeNetwork *> &networks, double maxWaitMs)
+        : _networks(networks), _maxWaitMs(maxWaitMs), _batchSize(maxBatchOf(networks)) {
+        _thread = std::thread(&AttributeBatcher::run, this);
+    }
+
+    ~AttributeBatcher() {
+        stop();
+    }
+
+    std::future<void> submit(const AttributeJob::Ptr &job) {
+        std::future<void> future = job->done.get_future();
+        job->enqueued = std::chrono::high_resolution_clock::now();
+        job->remaining = job->faces.size();
+        job->records.resize(job->faces.size());
+        if (job->faces.empty() || _networks.empty()) {
+            job->done.set_value();
+            return future;
+        }
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            for (size_t i = 0; i < job->faces.size(); i++) {
+                _pending.push_back(std::make_pair(job, i));
+            }
+        }
+        _wakeUp.notify_one();
+        return future;
+    }
+
+    void stop() {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _stopped = true;
+        }
+        _wakeUp.notify_one();
+        if (_thread.joinable()) {
+            _thread.join();
+        }
+    }
+
+    void printStatistics() const {
+        if (_batches == 0) {
+            return;
+        }
+        slog::info << "   Second stage batches: " << _batches << " (" << _fullBatches << " full, "
+                   << _batches - _fullBatches << " started by the " << _maxWaitMs << " ms deadline)" << slog::endl;
+        slog::info << "     Avg batch fill: " << std::fixed << std::setprecision(2)
+                   << 100.0 * _faces / (_batches * _batchSize) << "% of " << _batchSize << " faces" << slog::endl;
+        slog::info << "     Avg wait for a batch: " << _waitMs / _faces << " ms per face" << slog::endl;
+    }
+
+private:
+    typedef std::chrono::duration<double, std::ratio<1, 1000>> ms;
+
+    static size_t maxBatchOf(const std::vector<AttributeNetwork *> &networks) {
+        int batchSize = 1;
+        for (auto &&network : networks) {
+            batchSize = std::max(batchSize, network->maxBatch);
+        }
+        return batchSize;
+    }
+
+    void run() {
+        std::vector<std::pair<AttributeJob::Ptr, size_t>> batch;
+        while (true) {
+            {
+                std::unique_lock<std::mutex> lock(_mutex);
+                _wakeUp.wait(lock, [this] { return _stopped || !_pending.empty(); });
+                if (_pending.empty()) {
+                    break;  // stopped and drained
+                }
+                auto deadline = _pending.front().first->enqueued +
+                    std::chrono::duration_cast<std::chrono::high_resolution_clock::duration>(ms(_maxWaitMs));
+                _wakeUp.wait_until(lock, deadline, [this] { return _stopped || _pending.size() >= _batchSize; });
+
+                const size_t count = std::min(_batchSize, _pending.size());
+                batch.assign(_pending.begin(), _pending.begin() + count);
+                _pending.erase(_pending.begin(), _pending.begin() + count);
+            }
+
+            auto start = std::chrono::high_resolution_clock::now();
+            std::vector<cv::Mat> faces;
+            std::vector<FaceRecord> records;
+            for (auto &&item : batch) {
+                faces.push_back(item.first->faces[item.second]);
+                records.push_back(item.first->records[item.second]);
+                _waitMs += std::chrono::duration_cast<ms>(start - item.first->enqueued).count();
+            }
+            const double inferenceMs = inferFaceAttributes(faces, _networks, records);
+
+            _batches++;
+            _faces += batch.size();
+            _fullBatches += batch.size() == _batchSize ? 1 : 0;
+
+            AttributeJob *last = nullptr;
+            for (size_t bi = 0; bi < batch.size(); bi++) {
+                AttributeJob &job = *batch[bi].first;
+                const size_t faceIdx = batch[bi].second;
+                job.records[faceIdx] = std::move(records[bi]);
+                if (&job != last) {
+                    job.batchWaitMs = std::max(job.batchWaitMs, std::chrono::duration_cast<ms>(start - job.enqueued).count());
+                    job.inferenceMs += inferenceMs;
+                    last = &job;
+                }
+                if (--job.remaining == 0) {
+                    job.done.set_value();
+                }
+            }
+            batch.clear();
+        }
+    }
+
+    const std::vector<AttributeNetwork *> _networks;
+    const double _maxWaitMs;
+    const size_t _batchSize;
+
+    std::mutex _mutex;
+    std::condition_variable _wakeUp;
+    std::deque<std::pair<AttributeJob::Ptr, size_t>> _pending;
+    bool _stopped = false;
+    std::thread _thread;
+
+    size_t _batches = 0;
+    size_t _fullBatches = 0;
+    size_t _faces = 0;
+    double _waitMs = 0;
+};
+
+#ifndef _WIN32
+static std::atomic<bool> serverStopRequested(false);
+
+static void requestServerStop(int) {
+    serverStopRequested = true;
+}
+
+/**
+* \brief Serves face detection and the second stage networks to local clients over a Unix domain socket.
+* A client sends length-prefixed encoded images (any format cv::imdecode reads) and gets one
+* length-prefixed JSON reply per image, in order:
+*   {"timing":{"queue_ms":..,"detect_ms":..,"batch_wait_ms":..,"infer_ms":..,"total_ms":..},"result":{<-ro record>}}
+* Every connection runs face detection on its own infer request, the faces of all connections
+* meet in the shared second stage batches. Stops on SIGINT or SIGTERM.
+*/
+void runInferenceServer(const std::string &socketPath, FaceDetectionClass &FaceDetection,
+                        const std::vector<AttributeNetwork *> &attributeNetworks) {
+    typedef std::chrono::duration<double, std::ratio<1, 1000>> ms;
+    const uint32_t maxMessageSize = 64 << 20;
+
+    int listenFd = UnixSocket::listen(socketPath);
+    std::signal(SIGINT, requestServerStop);
+    std::signal(SIGTERM, requestServerStop);
+    slog::info << "Serving on unix:" << socketPath << ", press Ctrl+C to stop" << slog::endl;
+
+    AttributeBatcher batcher(attributeNetworks, FLAGS_server_wait);
+    std::mutex statsMutex, requestsMutex;
+    size_t totalRequests = 0;
+    double totalQueueMs = 0, totalDetectMs = 0, totalBatchWaitMs = 0, totalInferMs = 0, totalMs = 0;
+
+    /** done is set by the thread once it closed its connection, the thread can then be joined **/
+    struct ClientThread {
+        std::thread thread;
+        std::shared_ptr<std::atomic<bool>> done;
+    };
+    std::vector<ClientThread> clients;
+    std::vector<int> clientFds;  // open connections, shut down when the server stops
+    std::mutex clientsMutex;
+    size_t totalConnections = 0;
+
+    auto serveClient = [&](int fd, std::shared_ptr<std::atomic<bool>> done) {
+        try {
+            FaceDetectionClass detector = FaceDetection;
+            {
+                std::lock_guard<std::mutex> lock(requestsMutex);
+                detector.request = detector.backend->createRequest();
+            }
+            std::vector<unsigned char> message;
+            int64_t requestIndex = 0;
+            while (UnixSocket::readMessage(fd, message, maxMessageSize)) {
+                auto received = std::chrono::high_resolution_clock::now();
+                FrameRecord record;
+                record.frameIndex = requestIndex++;
+                // an empty or malformed payload gets the error reply instead of ending the session,
+                // imdecode asserts on an empty buffer and some decoders throw on corrupt data
+                cv::Mat image;
+                if (!message.empty()) {
+                    try {
+                        image = cv::imdecode(message, cv::IMREAD_COLOR);
+                    } catch (const cv::Exception &) {
+                        image.release();
+                    }
+                }
+
+                auto detectStart = std::chrono::high_resolution_clock::now();
+                auto job = std::make_shared<AttributeJob>();
+                if (!image.empty()) {
+                    detector.enqueue(image);
+                    detector.submitRequest();
+                    detector.wait();
+                    detector.fetchResults();
+                    for (auto &&faceResult : detector.results) {
+                        job->faces.push_back(cropFace(image, faceResult.location));
+                        job->records.push_back(makeFaceRecord(faceResult));
+                    }
+                }
+                auto detectEnd = std::chrono::high_resolution_clock::now();
+                batcher.submit(job).wait();
+                auto end = std::chrono::high_resolution_clock::now();
+
+                record.faces = std::move(job->records);
+
+                const double queueMs = std::chrono::duration_cast<ms>(detectStart - received).count();
+                const double detectMs = std::chrono::duration_cast<ms>(detectEnd - detectStart).count();
+                const double requestMs = std::chrono::duration_cast<ms>(end - received).count();
+                char timing[256];
+                std::snprintf(timing, sizeof(timing),
+                              "{\"timing\":{\"queue_ms\":%.3f,\"detect_ms\":%.3f,\"batch_wait_ms\":%.3f,\"infer_ms\":%.3f,"
+                              "\"total_ms\":%.3f},%s\"result\":",
+                              queueMs, detectMs, job->batchWaitMs, job->inferenceMs, requestMs,
+                              image.empty() ? "\"error\":\"cannot decode image\"," : "");
+                std::string reply = timing;
+                ResultsFormat::appendJson(reply, record);
+                reply.back() = '}';  // replaces the record's trailing newline
+
+                {
+                    std::lock_guard<std::mutex> lock(statsMutex);
+                    totalRequests++;
+                    totalQueueMs += queueMs;
+                    totalDetectMs += detectMs;
+                    totalBatchWaitMs += job->batchWaitMs;
+                    totalInferMs += job->inferenceMs;
+                    totalMs += requestMs;
+                }
+                if (!UnixSocket::writeMessage(fd, reply)) {
+                    break;
+                }
+            }
+        } catch (const std::exception& error) {
+            slog::err << "Client connection failed: " << error.what() << slog::endl;
+        }
+        // closed under the lock, so the server never shuts down a descriptor that was reused meanwhile
+        {
+            std::lock_guard<std::mutex> lock(clientsMutex);
+            clientFds.erase(std::remove(clientFds.begin(), clientFds.end(), fd), clientFds.end());
+            ::close(fd);
+        }
+        *done = true;
+    };
+
+    // joins the threads of clients that disconnected, so a long running server does not keep them
+    auto reapClients = [&] {
+        for (auto client = clients.begin(); client != clients.end();) {
+            if (*client->done) {
+                client->thread.join();
+                client = clients.erase(client);
+            } else {
+                ++client;
+            }
+        }
+    };
+
+    while (!serverStopRequested) {
+        reapClients();
+        int fd = UnixSocket::accept(listenFd, 200);
+        if (fd < 0) {
+            continue;
+        }
+        std::lock_guard<std::mutex> lock(clientsMutex);
+        clientFds.push_back(fd);
+        ClientThread client;
+        client.done = std::make_shared<std::atomic<bool>>(false);
+        client.thread = std::thread(serveClient, fd, client.done);
+        clients.push_back(std::move(client));
+        totalConnections++;
+    }
+
+    slog::info << "Stopping server" << slog::endl;
+    ::close(listenFd);
+    ::unlink(socketPath.c_str());
+    {
+        std::lock_guard<std::mutex> lock(clientsMutex);
+        for (auto &&fd : clientFds) {
+            ::shutdown(fd, SHUT_RDWR);  // unblocks clients waiting for their next request
+        }
+    }
+    for (auto &&client : clients) {
+        client.thread.join();
+    }
+    batcher.stop();
+
+    std::string nb(80, '-');
+    std::cout << nb << std::endl;
+    slog::info << "   Requests served: " << totalRequests << " on " << totalConnections << " connections" << slog::endl;
+    if (totalRequests > 0) {
+        slog::info << "     Avg queue time:       " << std::fixed << std::setprecision(2) << totalQueueMs / totalRequests << " ms" << slog::endl;
+        slog::info << "     Avg detection time:   " << totalDetectMs / totalRequests << " ms" << slog::endl;
+        slog::info << "     Avg batch wait time:  " << totalBatchWaitMs / totalRequests << " ms" << slog::endl;
+        slog::info << "     Avg second stage time:" << totalInferMs / totalRequests << " ms" << slog::endl;
+        slog::info << "     Avg request time:     " << totalMs / totalRequests << " ms" << slog::endl;
+    }
+    batcher.printStatistics();
+    std::cout << nb << std::endl;
+}
+#endif
+
+int main(int argc, char *argv[]) {
+    try {
+        /** This sample covers 3 certain topologies and cannot be generalized **/
+        std::cout << "InferenceEngine: " << InferenceEngine::GetInferenceEngineVersion() << std::endl;
+
+        // ---------------------------Parsing and validation of input args--------------------------------------
+        if (!ParseAndCheckCommandLine(argc, argv)) {
+            return 0;
+        }
+
+        // -----------------------------Read input -----------------------------------------------------
+        slog::info << "Reading input" << slog::endl;
+        std::unique_ptr<FrameSource> source;
+        cv::Mat frame;
+        cv::Size frameSize;
+        bool firstFrameRead = false;
+        const std::string shmPrefix = "shm:";
+        const bool isServer = !FLAGS_server.empty();
+        const bool isImageDirectory = !isServer && FLAGS_i != "cam" && isDirectory(FLAGS_i);
+        if (!isImageDirectory && !isServer) {
+            if (FLAGS_i.compare(0, shmPrefix.size(), shmPrefix) == 0) {
+#ifdef _WIN32
+                throw std::logic_error("Shared memory input is not supported on Windows");
+#else
+                source.reset(new ShmFrameSource(FLAGS_i.substr(shmPrefix.size()), FLAGS_shm_timeout));
+#endif
+            } else {
+                source.reset(new VideoCaptureSource(FLAGS_i));
+            }
+
+            // the first frame is only decoded up front if the source does not report its size, so
+            // replaying cached crops never decodes the video
+            frameSize = source->frameSize();
+            if (frameSize.area() <= 0) {
+                if (!source->read(frame)) {
+                    throw std::logic_error("Failed to get frame from " + FLAGS_i);
+                }
+                frameSize = cv::Size(frame.cols, frame.rows);
+                firstFrameRead = true;
+            }
+        }
+
+        // annotated frames are encoded on a background thread, so headless runs keep their output
+        std::unique_ptr<AsyncFrameWriter> outputWriter;
+        if (!FLAGS_o.empty() && !source) {
+            slog::warn << "Annotated output is only written for video input, use -ro for per-image results" << slog::endl;
+        } else if (!FLAGS_o.empty()) {
+            slog::info << "Writing annotated output to " << FLAGS_o << slog::endl;
+            outputWriter.reset(new AsyncFrameWriter(FLAGS_o, FLAGS_o_fourcc, source->fps(),
+                                                    frameSize, FLAGS_o_queue));
+        }
+
+        std::unique_ptr<ResultsWriter> resultsWriter;
+        if (!FLAGS_ro.empty()) {
+            slog::info << "Writing structured results to " << FLAGS_ro << slog::endl;
+            resultsWriter.reset(new ResultsWriter(FLAGS_ro, FLAGS_ro_fmt, FLAGS_ro_drop));
+        }
+
+        // ---------------------Load plugins for inference engine------------------------------------------------
+        std::map<std::string, InferencePlugin> pluginsForDevices;
+
+        // small faces of high resolution streams are detected on overlapping tiles
+        std::vector<cv::Rect> tiles;
+        if (!FLAGS_fd_tiles.empty() && !source) {
+            slog::warn << "Tiled Face Detection is only used for video input" << slog::endl;
+        } else if (!FLAGS_fd_tiles.empty()) {
+            int cols = 0, rows = 0;
+            char tail = 0;
+            if (std::sscanf(FLAGS_fd_tiles.c_str(), "%dx%d%c", &cols, &rows, &tail) != 2 || cols < 1 || rows < 1) {
+                throw std::logic_error("Parameter -fd_tiles should be <columns>x<rows>, but was: " + FLAGS_fd_tiles);
+            }
+            tiles = TiledFaceDetection::makeTiles(frameSize, cols, rows,
+                                                  FLAGS_fd_tile_overlap, FLAGS_fd_tile_full);
+        }
+        const int faceDetectionBatch = isImageDirectory ? FLAGS_n_fd :
+                                       !tiles.empty() && !FLAGS_fd_tile_async ? static_cast<int>(tiles.size()) : 1;
+
+        FaceDetectionClass FaceDetection(faceDetectionBatch);
+        configureDetectorReshape(FaceDetection, FLAGS_fd_reshape, tiles.empty() ? frameSize : tiles.front().size());
+        AgeGenderDetection AgeGender;
+        HeadPoseDetection HeadPose;
+
+        // registry of the second stage networks, all of them run on every face crop
+        std::vector<std::unique_ptr<AttributeNetwork>> extraNetworks = createAttributeNetworks(FLAGS_m_attr);
+        std::vector<AttributeNetwork *> attributeNetworks;
+        if (AgeGender.enabled()) {
+            attributeNetworks.push_back(&AgeGender);
+        }
+        if (HeadPose.enabled()) {
+            attributeNetworks.push_back(&HeadPose);
+        }
+        for (auto &&network : extraNetworks) {
+            attributeNetworks.push_back(network.get());
+        }
+
+        // the stub backend makes up results without plugins or model files
+        const bool stubBackend = FLAGS_backend == "stub";
+        std::vector<std::pair<std::string, std::string>> cmdOptions;
+        if (!stubBackend) {
+            cmdOptions.push_back(std::make_pair(FLAGS_d, FLAGS_m));
+            for (auto &&network : attributeNetworks) {
+                cmdOptions.push_back(std::make_pair(network->deviceName, network->modelPath));
+            }
+        } else {
+            slog::info << "Using the stub backend, results are synthetic" << slog::endl;
+        }
+
+        for (auto && option : cmdOptions) {
+            auto deviceName = option.first;
+            auto networkName = option.second;
+
+            if (deviceName == "" || networkName == "") {
+                continue;
+            }
+
+            if (pluginsForDevices.find(deviceName) != pluginsForDevices.end()) {
+                continue;
+            }
+            slog::info << "Loading plugin " << deviceName << slog::endl;
+            InferencePlugin plugin = PluginDispatcher({"../../../lib/intel64", ""}).getPluginByDevice(deviceName);
+
+            /** Printing plugin version **/
+            printPluginVersion(plugin, std::cout);
+
+            /** Load extensions for the CPU plugin **/
+            if ((deviceName.find("CPU") != std::string::npos)) {
+                plugin.AddExtension(std::make_shared<Extensions::Cpu::CpuExtensions>());
+
+                if (!FLAGS_l.empty()) {
+                    // CPU(MKLDNN) extensions are loaded as a shared library and passed as a pointer to base extension
                     //auto extension_ptr = make_so_pointer<InferenceEngine::MKLDNNPlugin::IMKLDNNExtension>(FLAGS_l);		// 4.20
                     auto extension_ptr = make_so_pointer<IExtension>(FLAGS_l);												// 4.20
                     plugin.AddExtension(std::static_pointer_cast<IExtension>(extension_ptr));
@@ -686,17 +2084,198 @@ int main(int argc, char *argv[]) {
 
         // --------------------Load networks (Generated xml/bin files)-------------------------------------------
 
-        Load(FaceDetection).into(pluginsForDevices[FLAGS_d]);
-        Load(AgeGender).into(pluginsForDevices[FLAGS_d_ag]);
-        Load(HeadPose).into(pluginsForDevices[FLAGS_d_hp]);
+        const std::map<std::string, LatencyModel> stubLatencies = parseStubLatencies(FLAGS_stub_latency);
+        auto load = [&](BaseDetection &detector) {
+            if (stubBackend) {
+                Load(detector).intoStub(stubLatencies, FLAGS_stub_seed);
+            } else {
+                Load(detector).into(pluginsForDevices[detector.deviceName]);
+            }
+        };
+        load(FaceDetection);
+        for (auto &&network : attributeNetworks) {
+            load(*network);
+        }
+        std::unique_ptr<TiledFaceDetection> tiledDetection;
+        if (!tiles.empty()) {
+            tiledDetection.reset(new TiledFaceDetection(FaceDetection, tiles, FLAGS_fd_tile_async,
+                                                        static_cast<float>(FLAGS_fd_tile_nms)));
+        }
+        std::vector<BaseDetection *> allNetworks = {&FaceDetection};
+        allNetworks.insert(allNetworks.end(), attributeNetworks.begin(), attributeNetworks.end());
+
+        // CPU time of the processing mode that runs below, reported by finishRun
+        CpuAccounting cpu;
+
+        // ----------------------------Compare model variants--------------------------------------------------
+        if (!FLAGS_ab_m.empty() || !FLAGS_ab_m_ag.empty() || !FLAGS_ab_m_hp.empty()) {
+            if (isServer) {
+                throw std::logic_error("Precision comparison cannot be combined with -server");
+            }
+            std::unique_ptr<FaceDetectionClass> FaceDetectionB;
+            std::unique_ptr<AgeGenderDetection> AgeGenderB;
+            std::unique_ptr<HeadPoseDetection> HeadPoseB;
+            std::vector<std::pair<AttributeNetwork *, AttributeNetwork *>> attributePairs;
+            if (!FLAGS_ab_m.empty()) {
+                FaceDetectionB.reset(new FaceDetectionClass(faceDetectionBatch, FLAGS_ab_m, FLAGS_d));
+                configureDetectorReshape(*FaceDetectionB, FLAGS_fd_reshape, tiles.empty() ? frameSize : tiles.front().size());
+                FaceDetectionB->topoName += " B";
+                load(*FaceDetectionB);
+                allNetworks.push_back(FaceDetectionB.get());
+            }
+            if (!FLAGS_ab_m_ag.empty()) {
+                AgeGenderB.reset(new AgeGenderDetection(FLAGS_ab_m_ag));
+                AgeGenderB->topoName += " B";
+                load(*AgeGenderB);
+                attributePairs.push_back(std::make_pair(&AgeGender, AgeGenderB.get()));
+                allNetworks.push_back(AgeGenderB.get());
+            }
+            if (!FLAGS_ab_m_hp.empty()) {
+                HeadPoseB.reset(new HeadPoseDetection(FLAGS_ab_m_hp));
+                HeadPoseB->topoName += " B";
+                load(*HeadPoseB);
+                attributePairs.push_back(std::make_pair(&HeadPose, HeadPoseB.get()));
+                allNetworks.push_back(HeadPoseB.get());
+            }
+
+            // a frame read up front comes first, directories are read image by image
+            bool firstFrame = firstFrameRead;
+            const std::vector<std::string> files = isImageDirectory ? listImageFiles(FLAGS_i) : std::vector<std::string>();
+            size_t nextFile = 0;
+            auto nextFrame = [&](cv::Mat &next) -> bool {
+                if (source) {
+                    if (firstFrame) {
+                        firstFrame = false;
+                        next = frame;
+                        return true;
+                    }
+                    return source->read(next);
+                }
+                while (nextFile < files.size()) {
+                    next = cv::imread(files[nextFile++]);
+                    if (!next.empty()) {
+                        return true;
+                    }
+                }
+                return false;
+            };
+            runPrecisionComparison(nextFrame, FLAGS_ab_frames, FaceDetection, FaceDetectionB.get(), attributePairs);
+            finishRun(allNetworks, attributeNetworks, outputWriter.get(), resultsWriter.get(), cpu, 0, 0);
+            return 0;
+        }
+
+        // ----------------------------Serve local clients-----------------------------------------------------
+        if (isServer) {
+#ifdef _WIN32
+            throw std::logic_error("Server mode is not supported on Windows");
+#else
+            runInferenceServer(FLAGS_server, FaceDetection, attributeNetworks);
+            finishRun(allNetworks, attributeNetworks, outputWriter.get(), resultsWriter.get(), cpu, 0, 0);
+            return 0;
+#endif
+        }
 
+        // ----------------------------Process image directory--------------------------------------------------
+        if (isImageDirectory) {
+            cpu.start();
+            const size_t images = processImageDirectory(FLAGS_i, FaceDetection, attributeNetworks, resultsWriter.get());
+            finishRun(allNetworks, attributeNetworks, outputWriter.get(), resultsWriter.get(), cpu, images, 0);
+            return 0;
+        }
+
+        // analytics at a low rate process every frameStride-th frame, the others are grabbed but not retrieved
+        size_t frameStride = FLAGS_stride;
+        if (FLAGS_target_fps > 0 && source->fps() > 0) {
+            frameStride = std::max<size_t>(1, static_cast<size_t>(std::lround(source->fps() / FLAGS_target_fps)));
+        }
+        if (frameStride > 1) {
+            slog::info << "Processing every " << frameStride << " frames" << slog::endl;
+        }
+
+        // ----------------------------Replay or record cached detections--------------------------------------
+        std::unique_ptr<DetectionCacheWriter> cacheWriter;
+        if (!FLAGS_det_cache.empty()) {
+            if (FLAGS_i == "cam" || dynamic_cast<VideoCaptureSource *>(source.get()) == nullptr) {
+                throw std::logic_error("Parameter -det_cache needs a video file as input");
+            }
+            // crops are stored at the largest input of the second stage, the others resize them again
+            cv::Size cropSize;
+            for (auto &&network : attributeNetworks) {
+                if (network->inputSize.area() > cropSize.area()) {
+                    cropSize = network->inputSize;
+                }
+            }
+            if (!FLAGS_det_cache_crops) {
+                cropSize = cv::Size();
+            }
+            // besides the model, custom layers of the CPU extension or clDNN kernels change the detections
+            std::vector<std::string> modelFiles;
+            if (!FLAGS_m.empty()) {
+                modelFiles = {FLAGS_m, fileNameNoExt(FLAGS_m) + ".bin"};
+            }
+            if (!FLAGS_l.empty()) {
+                modelFiles.push_back(FLAGS_l);
+            }
+            if (!FLAGS_c.empty()) {
+                modelFiles.push_back(FLAGS_c);
+            }
+            // the device decides the precision the detector runs in, e.g. FP32 on CPU and FP16 on GPU or MYRIAD
+            std::ostringstream settings;
+            settings << "d=" << FLAGS_d << ";t=" << FLAGS_t << ";backend=" << FLAGS_backend
+                     << ";stub_faces=" << FLAGS_stub_faces
+                     << ";stub_seed=" << FLAGS_stub_seed << ";fd_reshape=" << FLAGS_fd_reshape << ";fd_tiles=" << FLAGS_fd_tiles
+                     << ";fd_tile_overlap=" << FLAGS_fd_tile_overlap << ";fd_tile_full=" << FLAGS_fd_tile_full
+                     << ";fd_tile_nms=" << FLAGS_fd_tile_nms
+                     << ";stride=" << frameStride << ";crops=" << cropSize.width << "x" << cropSize.height;
+            const uint64_t cacheKey = detectionCacheKey(FLAGS_i, modelFiles, settings.str());
+
+            std::unique_ptr<DetectionCache> cache = DetectionCache::open(FLAGS_det_cache, cacheKey);
+            if (cache) {
+                replayDetectionCache(*cache, *source, frame, firstFrameRead ? 0 : -1, attributeNetworks,
+                                     resultsWriter.get(), cpu);
+                finishRun(allNetworks, attributeNetworks, outputWriter.get(), resultsWriter.get(), cpu,
+                          cache->frameCount(), 0);
+                return 0;
+            }
+            if (FLAGS_seg_workers > 0) {
+                slog::warn << "Detections are not cached with -seg_workers" << slog::endl;
+            } else {
+                slog::info << "Recording detections to " << FLAGS_det_cache << slog::endl;
+                cacheWriter.reset(new DetectionCacheWriter(FLAGS_det_cache, cacheKey, cropSize));
+            }
+        }
+
+        // ----------------------------Process video file in parallel segments--------------------------------
+        if (FLAGS_seg_workers > 0) {
+            if (FLAGS_i == "cam" || dynamic_cast<VideoCaptureSource *>(source.get()) == nullptr) {
+                throw std::logic_error("Parameter -seg_workers needs a video file as input");
+            }
+            if (tiledDetection) {
+                slog::warn << "Tiled Face Detection is not used with -seg_workers" << slog::endl;
+            }
+            if (outputWriter) {
+                slog::warn << "Annotated output is not written with -seg_workers, use -ro for per-frame results" << slog::endl;
+            }
+            const double streamFps = source->fps() / frameStride;
+            source.reset();
+            const size_t frames = processVideoSegments(FLAGS_i, FaceDetection, attributeNetworks, resultsWriter.get(),
+                                                       FLAGS_seg_workers, frameStride, cpu);
+            finishRun(allNetworks, attributeNetworks, outputWriter.get(), resultsWriter.get(), cpu, frames, streamFps);
+            return 0;
+        }
 
         // ----------------------------Do inference-------------------------------------------------------------
+        if (!firstFrameRead && !source->read(frame)) {
+            throw std::logic_error("Failed to get frame from " + FLAGS_i);
+        }
         slog::info << "Start inference " << slog::endl;
         typedef std::chrono::duration<double, std::ratio<1, 1000>> ms;
         std::chrono::high_resolution_clock::time_point wallclockStart, wallclockEnd;
 
-        int totalFrames = 1;  // cap.read() above
+        int totalFrames = 1;  // source->read() above
+        int64_t sourceFrameIndex = 0;
+        size_t skippedFrames = 0;
+        double sourceTime = 0;  // grab and retrieve of the processed frames and grab of the skipped ones
         double ocv_decode_time = 0, ocv_render_time = 0;
 		float fdFpsTot = 0.0; 
 		float otherTotFps = 0.0; 
@@ -705,146 +2284,127 @@ int main(int argc, char *argv[]) {
 		double ocv_ttl_decode = 0;
 
 		wallclockStart = std::chrono::high_resolution_clock::now();
-        /** Start inference & calc performance **/
-        while (true) {
-        	double secondDetection = 0;
-
-            /** requesting new frame if any*/
-            cap.grab();
-
-            auto t0 = std::chrono::high_resolution_clock::now();
-            FaceDetection.enqueue(frame);
-            auto t1 = std::chrono::high_resolution_clock::now();
-            ocv_decode_time = std::chrono::duration_cast<ms>(t1 - t0).count();
-
-            t0 = std::chrono::high_resolution_clock::now();
-            // ----------------------------Run face detection inference------------------------------------------
-            FaceDetection.submitRequest();
-            FaceDetection.wait();
+        double frameTimestampMs = source->timestampMs();
 
-            t1 = std::chrono::high_resolution_clock::now();
-            ms detection = std::chrono::duration_cast<ms>(t1 - t0);
-
-            // fetch all face results
-            FaceDetection.fetchResults();
-
-            // track and store age and gender results for all faces
-            std::vector<AgeGenderDetection::Result> ageGenderResults;
-            int ageGenderFaceIdx = 0;
-            int ageGenderNumFacesInferred = 0;
-            int ageGenderNumFacesToInfer = AgeGender.enabled() ? FaceDetection.results.size() : 0;
-
-            // track and store head pose results for all faces
-            std::vector<HeadPoseDetection::Results> headPoseResults;
-            int headPoseFaceIdx = 0;
-            int headPoseNumFacesInferred = 0;
-            int headPoseNumFacesToInfer = HeadPose.enabled() ? FaceDetection.results.size() : 0;
-
-
-            while((ageGenderFaceIdx < ageGenderNumFacesToInfer)
-        		   || (headPoseFaceIdx < headPoseNumFacesToInfer)) {
-            	// enqueue input batch
-            	while ((ageGenderFaceIdx < ageGenderNumFacesToInfer) && (AgeGender.enquedFaces < AgeGender.maxBatch)) {
-					FaceDetectionClass::Result faceResult = FaceDetection.results[ageGenderFaceIdx];
-					auto clippedRect = faceResult.location & cv::Rect(0, 0, width, height);
-					auto face = frame(clippedRect);
-					AgeGender.enqueue(face);
-					ageGenderFaceIdx++;
-            	}
-
-            	while ((headPoseFaceIdx < headPoseNumFacesToInfer) && (HeadPose.enquedFaces < HeadPose.maxBatch)) {
-					FaceDetectionClass::Result faceResult = FaceDetection.results[headPoseFaceIdx];
-					auto clippedRect = faceResult.location & cv::Rect(0, 0, width, height);
-					auto face = frame(clippedRect);
-					HeadPose.enqueue(face);
-					headPoseFaceIdx++;
-            	}
+        // CPU time of the stages of this loop and of the whole process, including the plugin thread pools
+        cpu.start();
 
-				t0 = std::chrono::high_resolution_clock::now();
-
-            	// if faces are enqueued, then start inference
-            	if (AgeGender.enquedFaces > 0) {
-					AgeGender.submitRequest();
-            	}
-            	if (HeadPose.enquedFaces > 0) {
-            		HeadPose.submitRequest();
-            	}
-
-            	// if there are outstanding results, then wait for inference to complete
-            	if (ageGenderNumFacesInferred < ageGenderFaceIdx) {
-					AgeGender.wait();
-            	}
-            	if (headPoseNumFacesInferred < headPoseFaceIdx) {
-            		HeadPose.wait();
-            	}
+        // frames mapped from shared memory are read-only, annotations go to a private copy
+        const bool annotate = !source->zeroCopy() || !FLAGS_no_show || outputWriter;
 
-				t1 = std::chrono::high_resolution_clock::now();
-				secondDetection += std::chrono::duration_cast<ms>(t1 - t0).count();
+        // the second stage may start on predicted faces while the detector runs
+        std::unique_ptr<FaceSpeculation> speculation;
+        if (FLAGS_spec && tiledDetection) {
+            slog::warn << "Speculative second stage is not used with tiled Face Detection" << slog::endl;
+        } else if (FLAGS_spec && !attributeNetworks.empty()) {
+            speculation.reset(new FaceSpeculation(static_cast<float>(FLAGS_spec_iou)));
+        }
 
-				// process results if there are any
-				if (ageGenderNumFacesInferred < ageGenderFaceIdx) {
-					for(int ri = 0; ri < AgeGender.maxBatch; ri++) {
-						ageGenderResults.push_back(AgeGender[ri]);
-						ageGenderNumFacesInferred++;
-					}
-            	}
-				if (headPoseNumFacesInferred < headPoseFaceIdx) {
-					for(int ri = 0; ri < HeadPose.maxBatch; ri++) {
-						headPoseResults.push_back(HeadPose[ri]);
-						headPoseNumFacesInferred++;
-					}
-            	}
+        // second stage batches of several frames, the networks are then only used by the batcher thread
+        std::unique_ptr<AttributeBatcher> batcher;
+        if (FLAGS_mb_frames > 0 && !attributeNetworks.empty()) {
+            if (speculation) {
+                slog::warn << "Speculative second stage is not used with -mb_frames" << slog::endl;
+                speculation.reset();
             }
+            batcher.reset(new AttributeBatcher(attributeNetworks, FLAGS_mb_wait));
+        }
 
-            // ----------------------------Processing outputs-----------------------------------------------------
+        /** A processed frame waiting for its second stage results, frames are rendered in order **/
+        struct PendingFrame {
+            cv::Mat frame;
+            std::vector<FaceDetectionClass::Result> faceResults;
+            FrameRecord record;
+            double detectionMs = 0;
+            double secondStageMs = 0;
+            AttributeJob::Ptr job;
+            std::future<void> done;
+        };
+        std::deque<PendingFrame> pendingFrames;
+        size_t maxPendingFrames = 0;
+        bool endOfStream = false;  // all frames were processed, not stopped by a key
+        cv::Mat shownFrame;
+
+        /** Annotates, shows and writes one frame, false when a key asked to stop **/
+        auto renderFrame = [&](PendingFrame &pending) -> bool {
 			ocv_ttl_render += ocv_render_time;
 			ocv_ttl_decode += ocv_decode_time;
 
+            cv::Mat &frame = pending.frame;
+            const std::vector<FaceDetectionClass::Result> &faceResults = pending.faceResults;
+            FrameRecord &record = pending.record;
+            if (annotate && source->zeroCopy()) {
+                frame = frame.clone();
+            }
+
             std::ostringstream out;
             out << "OpenCV cap/render time: " << std::fixed << std::setprecision(2)
                 << (ocv_decode_time + ocv_render_time) << " ms";
-            cv::putText(frame, out.str(), cv::Point2f(0, 25), cv::FONT_HERSHEY_TRIPLEX, 0.5, cv::Scalar(255, 0, 0));
-						float currFdFps = 1000.f / detection.count();
+            if (annotate)
+                cv::putText(frame, out.str(), cv::Point2f(0, 25), cv::FONT_HERSHEY_TRIPLEX, 0.5, cv::Scalar(255, 0, 0));
+						float currFdFps = 1000.f / pending.detectionMs;
 						fdFpsTot += currFdFps;
 
             out.str("");
-            out << "Face detection time  : " << std::fixed << std::setprecision(2) << detection.count()
+            out << "Face detection time  : " << std::fixed << std::setprecision(2) << pending.detectionMs
                 << " ms ("
                 << currFdFps << " fps)";
-            cv::putText(frame, out.str(), cv::Point2f(0, 45), cv::FONT_HERSHEY_TRIPLEX, 0.5,
-                        cv::Scalar(255, 0, 0));
+            if (annotate)
+                cv::putText(frame, out.str(), cv::Point2f(0, 45), cv::FONT_HERSHEY_TRIPLEX, 0.5,
+                            cv::Scalar(255, 0, 0));
 
-            if (HeadPose.enabled() || AgeGender.enabled()) {
+            if (!attributeNetworks.empty()) {
                 out.str("");
-                out << (AgeGender.enabled() ? "Age Gender"  : "")
-                    << (AgeGender.enabled() && HeadPose.enabled() ? "+"  : "")
-                    << (HeadPose.enabled() ? "Head Pose "  : "")
-                    << "time: "<< std::fixed << std::setprecision(2) << secondDetection
+                for (size_t n = 0; n < attributeNetworks.size(); n++) {
+                    out << (n ? "+" : "") << attributeNetworks[n]->topoName;
+                }
+                out << " time: "<< std::fixed << std::setprecision(2) << pending.secondStageMs
                     << " ms ";
-                if (!FaceDetection.results.empty()) {
-                    float otherFps = 1000.f / secondDetection;
+                if (!faceResults.empty()) {
+                    float otherFps = 1000.f / pending.secondStageMs;
 					otherTotFps += otherFps;
                     out << "(" << otherFps << " fps)";
                 }
-                cv::putText(frame, out.str(), cv::Point2f(0, 65), cv::FONT_HERSHEY_TRIPLEX, 0.5, cv::Scalar(255, 0, 0));
+                if (annotate)
+                    cv::putText(frame, out.str(), cv::Point2f(0, 65), cv::FONT_HERSHEY_TRIPLEX, 0.5, cv::Scalar(255, 0, 0));
             }
 
             // render results
-            for(int ri = 0; ri < FaceDetection.results.size(); ri++) {
-            	FaceDetectionClass::Result faceResult = FaceDetection.results[ri];
+            for(int ri = 0; ri < faceResults.size(); ri++) {
+            	FaceDetectionClass::Result faceResult = faceResults[ri];
+                const FaceRecord &face = record.faces[ri];
                 cv::Rect rect = faceResult.location;
 
                 out.str("");
 
-                if (AgeGender.enabled()) {
-                    out << (ageGenderResults[ri].maleProb > 0.5 ? "M" : "F");
-                    out << std::fixed << std::setprecision(0) << "," << ageGenderResults[ri].age;
+                if (face.hasAgeGender) {
+                    out << (face.maleProb > 0.5 ? "M" : "F");
+                    out << std::fixed << std::setprecision(0) << "," << face.age;
                 } else {
                     out << (faceResult.label < FaceDetection.labels.size() ? FaceDetection.labels[faceResult.label] :
                              std::string("label #") + std::to_string(faceResult.label))
                         << ": " << std::fixed << std::setprecision(3) << faceResult.confidence;
                 }
 
+                if (FLAGS_r) {
+                    std::cout << "Predicted gender, age = " << out.str() << '\n';
+                    if (face.hasHeadPose) {
+                        std::cout << "Head pose results: yaw, pitch, roll = " << face.yaw << ";"
+                                  << face.pitch << ";" << face.roll << '\n';
+                    }
+                    for (auto &&attribute : face.attributes) {
+                        std::cout << attribute.first << " =";
+                        for (float value : attribute.second) {
+                            std::cout << ' ' << value;
+                        }
+                        std::cout << '\n';
+                    }
+                }
+
+                if (!annotate) {
+                    continue;
+                }
+
                 cv::putText(frame,
                             out.str(),
                             cv::Point2f(faceResult.location.x, faceResult.location.y - 15),
@@ -852,60 +2412,215 @@ int main(int argc, char *argv[]) {
                             0.8,
                             cv::Scalar(0, 0, 255));
 
-                if (FLAGS_r) {
-                    std::cout << "Predicted gender, age = " << out.str() << std::endl;
-                }
-
-                if (HeadPose.enabled()) {
+                if (face.hasHeadPose) {
                     cv::Point3f center(rect.x + rect.width / 2, rect.y + rect.height / 2, 0);
-                    HeadPose.drawAxes(frame, center, headPoseResults[ri], 50);
+                    HeadPose.drawAxes(frame, center, {face.roll, face.pitch, face.yaw}, 50);
                 }
 
                 auto genderColor =
-                		(AgeGender.enabled()) ?
-                              ((ageGenderResults[ri].maleProb < 0.5) ? cv::Scalar(0, 0, 255) : cv::Scalar(255, 0, 0)) :
+                		(face.hasAgeGender) ?
+                              ((face.maleProb < 0.5) ? cv::Scalar(0, 0, 255) : cv::Scalar(255, 0, 0)) :
                               cv::Scalar(0, 255, 0);
                 cv::rectangle(frame, faceResult.location, genderColor, 2);
             }
 
+            if (outputWriter) {
+                outputWriter->push(frame);
+            }
+            if (resultsWriter) {
+                resultsWriter->push(std::move(record));
+            }
+
             int keyPressed;
             if (-1 != (keyPressed = cv::waitKey(1))) {
             	// done processing, save time
             	wallclockEnd = std::chrono::high_resolution_clock::now();
+                cpu.stop();
 
             	if ('s' == keyPressed) {
             		// save screen to output file
             		slog::info << "Saving screenshot" << slog::endl;
             		cv::imwrite("snapshot.bmp", frame);
             	} else {
-            		break;
+            		return false;
             	}
             }
 
-            t0 = std::chrono::high_resolution_clock::now();
+            auto t0 = std::chrono::high_resolution_clock::now();
             if (!FLAGS_no_show)
                 cv::imshow("Detection results", frame);
 
-            t1 = std::chrono::high_resolution_clock::now();
+            auto t1 = std::chrono::high_resolution_clock::now();
             ocv_render_time = std::chrono::duration_cast<ms>(t1 - t0).count();
+            return true;
+        };
+
+        /** Renders the oldest frames whose results are there, all of them with drain, and at most -mb_frames are held back **/
+        auto renderPendingFrames = [&](bool drain) -> bool {
+            while (!pendingFrames.empty()) {
+                PendingFrame &oldest = pendingFrames.front();
+                if (oldest.job) {
+                    const bool ready = oldest.done.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+                    if (!ready && !drain && pendingFrames.size() <= FLAGS_mb_frames) {
+                        break;
+                    }
+                    oldest.done.wait();
+                    oldest.record.faces = std::move(oldest.job->records);
+                    oldest.secondStageMs = oldest.job->inferenceMs;
+                }
+                const bool proceed = renderFrame(oldest);
+                shownFrame = oldest.frame;
+                pendingFrames.pop_front();
+                if (!proceed) {
+                    return false;
+                }
+            }
+            return true;
+        };
+
+        /** Start inference & calc performance **/
+        while (true) {
+        	double secondDetection = 0;
+
+            /** requesting new frame if any, frames skipped by -stride are grabbed but never retrieved */
+            auto grabStart = std::chrono::high_resolution_clock::now();
+            size_t grabbed = 0;
+            while (grabbed < frameStride && source->grab()) {
+                grabbed++;
+            }
+            sourceTime += std::chrono::duration_cast<ms>(std::chrono::high_resolution_clock::now() - grabStart).count();
+            cpu.lap("source");
+
+            auto t0 = std::chrono::high_resolution_clock::now();
+            if (!tiledDetection) {
+                FaceDetection.enqueue(frame);
+            }
+            auto t1 = std::chrono::high_resolution_clock::now();
+            ocv_decode_time = std::chrono::duration_cast<ms>(t1 - t0).count();
+            cpu.lap("preprocess");
+
+            t0 = std::chrono::high_resolution_clock::now();
+            // ----------------------------Run face detection inference------------------------------------------
+            std::vector<FaceRecord> speculativeFaces;
+            if (tiledDetection) {
+                tiledDetection->detect(frame);
+            } else {
+                FaceDetection.submitRequest();
+                if (speculation) {
+                    // overlaps with face detection, whose time then includes the longer of the two
+                    std::vector<cv::Mat> predictedFaces;
+                    speculativeFaces = speculation->predict(cv::Size(frame.cols, frame.rows));
+                    for (auto &&face : speculativeFaces) {
+                        predictedFaces.push_back(cropFace(frame, face.location));
+                    }
+                    secondDetection += inferFaceAttributes(predictedFaces, attributeNetworks, speculativeFaces);
+                }
+                FaceDetection.wait();
+            }
+
+            t1 = std::chrono::high_resolution_clock::now();
+            ms detection = std::chrono::duration_cast<ms>(t1 - t0);
+
+            // fetch all face results
+            if (!tiledDetection) {
+                FaceDetection.fetchResults();
+            }
+            const std::vector<FaceDetectionClass::Result> &faceResults =
+                tiledDetection ? tiledDetection->results : FaceDetection.results;
+            if (cacheWriter) {
+                cacheWriter->add(sourceFrameIndex, frameTimestampMs, frame, faceResults);
+            }
+            cpu.lap("detection");
+
+            // run all second stage networks on the faces of this frame
+            std::vector<cv::Mat> faces;
+            FrameRecord record;
+            record.frameIndex = sourceFrameIndex;
+            record.timestampMs = frameTimestampMs;
+            for (auto &&faceResult : faceResults) {
+                faces.push_back(cropFace(frame, faceResult.location));
+                record.faces.push_back(makeFaceRecord(faceResult));
+            }
+            AttributeJob::Ptr job;
+            if (batcher) {
+                // frames held back by the batcher must stay valid after the source moved on
+                if (source->zeroCopy()) {
+                    frame = frame.clone();
+                    faces.clear();
+                    for (auto &&faceResult : faceResults) {
+                        faces.push_back(cropFace(frame, faceResult.location));
+                    }
+                }
+                job = std::make_shared<AttributeJob>();
+                job->faces = std::move(faces);
+                job->records = record.faces;
+            } else if (speculation) {
+                // only new faces and faces that moved more than predicted go through the second stage again
+                std::vector<cv::Mat> missedFaces;
+                std::vector<FaceRecord> missedRecords;
+                const std::vector<size_t> misses = speculation->resolve(speculativeFaces, record.faces);
+                for (size_t fi : misses) {
+                    missedFaces.push_back(faces[fi]);
+                    missedRecords.push_back(record.faces[fi]);
+                }
+                secondDetection += inferFaceAttributes(missedFaces, attributeNetworks, missedRecords);
+                for (size_t mi = 0; mi < misses.size(); mi++) {
+                    record.faces[misses[mi]] = std::move(missedRecords[mi]);
+                }
+            } else {
+                secondDetection = inferFaceAttributes(faces, attributeNetworks, record.faces);
+            }
+
+            cpu.lap("second stage");
+
+            PendingFrame current;
+            current.frame = frame;
+            current.faceResults = faceResults;
+            current.record = std::move(record);
+            current.detectionMs = detection.count();
+            current.secondStageMs = secondDetection;
+            current.job = job;
+            if (job) {
+                current.done = batcher->submit(job);
+            }
+            pendingFrames.push_back(std::move(current));
+            maxPendingFrames = std::max(maxPendingFrames, pendingFrames.size());
+            if (!renderPendingFrames(false)) {
+                break;
+            }
+            cpu.lap("render/output");
+
 
             // end of file, for single frame file, like image we just keep it displayed to let user check what was shown
             cv::Mat newFrame;
-            if (!cap.retrieve(newFrame)) {
+            auto retrieveStart = std::chrono::high_resolution_clock::now();
+            const bool retrieved = grabbed > 0 && source->retrieve(newFrame);
+            sourceTime += std::chrono::duration_cast<ms>(std::chrono::high_resolution_clock::now() - retrieveStart).count();
+            cpu.lap("source");
+            if (!retrieved) {
+                if (!renderPendingFrames(true)) {
+                    break;
+                }
+                endOfStream = true;
+                cpu.lap("render/output");
             	// done processing, save time
             	wallclockEnd = std::chrono::high_resolution_clock::now();
+                cpu.stop();
 
 				if (!FLAGS_no_wait && !FLAGS_no_show) {
                     slog::info << "Press 's' key to save a screenshot, press any other key to exit" << slog::endl;
                     while (cv::waitKey(0) == 's') {
                 		// save screen to output file
                 		slog::info << "Saving screenshot of image" << slog::endl;
-                		cv::imwrite("screenshot.bmp", frame);
+                		cv::imwrite("screenshot.bmp", shownFrame);
                     }
                 }
                 break;
             }
             frame = newFrame;  // shallow copy
+            frameTimestampMs = source->timestampMs();
+            sourceFrameIndex += grabbed;
+            skippedFrames += grabbed - 1;
 			totalFrames++;
         }
 
@@ -925,6 +2640,12 @@ int main(int argc, char *argv[]) {
 		slog::info << "   Total main-loop time: " << std::fixed << std::setprecision(2)
 				<< total_wallclock_time.count() << " ms " <<  slog::endl;
 		slog::info << "     Total number of frames: " << totalFrames <<  slog::endl;
+        if (frameStride > 1) {
+            slog::info << "     Frames skipped without retrieving: " << skippedFrames << " (every " << frameStride
+                       << " frames processed)" << slog::endl;
+        }
+        slog::info << "     Avg grab/retrieve time per processed frame: " << std::fixed << std::setprecision(2)
+                   << sourceTime / totalFrames << " ms" << slog::endl;
 
 		std::cout << nb << std::endl;
 
@@ -949,13 +2670,36 @@ int main(int argc, char *argv[]) {
 
 		std::cout << nb << std::endl;
 
-        // ---------------------------Some perf data--------------------------------------------------
-        if (FLAGS_pc) {
-            FaceDetection.printPerformanceCounts();
-            AgeGender.printPerformanceCounts();
-            HeadPose.printPerformanceCounts();
+        source->printStatistics();
+        std::cout << nb << std::endl;
+        if (cacheWriter) {
+            // a run stopped early caches only part of the video, the next run records it again
+            cacheWriter->close(endOfStream);
+            if (!endOfStream) {
+                slog::warn << "Detection cache is incomplete, processing was stopped before the end of the video" << slog::endl;
+            }
+            cacheWriter->printStatistics();
+            std::cout << nb << std::endl;
+        }
+        if (batcher) {
+            batcher->stop();
+            slog::info << "   Micro-batching: up to " << maxPendingFrames << " frames held back for their second stage results"
+                       << slog::endl;
+            batcher->printStatistics();
+            std::cout << nb << std::endl;
+        }
+        if (speculation) {
+            speculation->printStatistics();
+            std::cout << nb << std::endl;
+        }
+        if (tiledDetection) {
+            tiledDetection->printStatistics();
+            std::cout << nb << std::endl;
         }
 
+        // ---------------------------Writers and perf data--------------------------------------------------
+        finishRun(allNetworks, attributeNetworks, outputWriter.get(), resultsWriter.get(), cpu, totalFrames,
+                  source->fps() / frameStride);
     } catch (const std::exception& error) {
         slog::err << error.what() << slog::endl;
         return 1;
@@ -963,7 +2707,5 @@ int main(int argc, char *argv[]) {
         slog::err << "Unknown/internal exception happened." << slog::endl;
         return 1;
     }
-
-    slog::info << "Execution successful" << slog::endl;
     return 0;
 }
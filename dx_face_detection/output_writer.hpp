@@ -0,0 +1,176 @@
+/*
+// Copyright (c) 2018 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma once
+
+#include <string>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <vector>
+#include <stdexcept>
+#include <cstdio>
+#include <cctype>
+#include <iomanip>
+
+#include <opencv2/opencv.hpp>
+#include <samples/slog.hpp>
+
+#include "bounded_queue.hpp"
+
+/**
+* \brief Checks an output path and returns whether it is an image sequence pattern. A path with a '%' needs
+* exactly one integer conversion, "%d" optionally zero-padded with a width of up to two digits (e.g. "%05d"),
+* and may contain "%%" for a literal '%'. Anything else would reach snprintf as an unchecked format string.
+*/
+inline bool checkOutputPattern(const std::string &path) {
+    size_t conversions = 0;
+    bool percent = false;
+    for (size_t i = 0; i < path.size(); i++) {
+        if (path[i] != '%') {
+            continue;
+        }
+        percent = true;
+        if (i + 1 < path.size() && path[i + 1] == '%') {
+            i++;
+            continue;
+        }
+        size_t end = i + 1;
+        if (end < path.size() && path[end] == '0') {
+            end++;
+        }
+        size_t digits = 0;
+        while (end < path.size() && std::isdigit(static_cast<unsigned char>(path[end]))) {
+            end++;
+            digits++;
+        }
+        if (digits > 2 || end >= path.size() || path[end] != 'd') {
+            throw std::logic_error("Output path may only contain an integer pattern like %d or %05d and %% for a "
+                                   "literal '%', but was: " + path);
+        }
+        conversions++;
+        i = end;
+    }
+    if (percent && conversions != 1) {
+        throw std::logic_error("Output image sequence pattern should contain exactly one integer pattern like %05d, "
+                               "but was: " + path);
+    }
+    return conversions == 1;
+}
+
+/**
+* \brief Writes annotated frames to a video file or a numbered image sequence on its own thread.
+* A path containing a printf-style integer pattern (e.g. "out/frame_%05d.jpg") selects the image
+* sequence (see checkOutputPattern), anything else is handed to cv::VideoWriter. Frames that do not fit into the queue are
+* dropped and counted instead of stalling the caller.
+*/
+class AsyncFrameWriter {
+public:
+    AsyncFrameWriter(const std::string &path, const std::string &fourcc, double fps, cv::Size frameSize,
+                     size_t queueSize)
+        : _path(path), _queue(queueSize), _imageSequence(checkOutputPattern(path)) {
+        if (!_imageSequence) {
+            if (fourcc.size() != 4) {
+                throw std::logic_error("Output FOURCC code should have 4 characters, but was: " + fourcc);
+            }
+            if (fps <= 0) {
+                fps = 30.0;
+            }
+            const int code = cv::VideoWriter::fourcc(fourcc[0], fourcc[1], fourcc[2], fourcc[3]);
+            if (!_video.open(path, code, fps, frameSize, true)) {
+                throw std::logic_error("Cannot open output video file: " + path);
+            }
+        }
+        _thread = std::thread(&AsyncFrameWriter::run, this);
+    }
+
+    ~AsyncFrameWriter() {
+        close();
+    }
+
+    /**
+    * The writer keeps a reference to the frame data, so the caller must not draw into
+    * the frame after it has been pushed.
+    */
+    void push(const cv::Mat &frame) {
+        _submitted++;
+        if (!_queue.tryPush(frame)) {
+            _dropped++;
+        }
+    }
+
+    void close() {
+        if (_thread.joinable()) {
+            _queue.close();
+            _thread.join();
+            _video.release();
+        }
+    }
+
+    /** Only valid after close(), the writer thread updates the encode time without synchronization **/
+    void printStatistics() const {
+        slog::info << "Output writer (" << _path << "): " << _written << " of " << _submitted << " frames written, "
+                   << _dropped << " dropped";
+        if (_submitted > 0) {
+            slog::info << " (" << std::fixed << std::setprecision(2) << 100.0 * _dropped / _submitted << "%)";
+        }
+        slog::info << slog::endl;
+        if (_written > 0) {
+            slog::info << "     Avg encode time: " << std::fixed << std::setprecision(2)
+                       << _encodeMs / _written << " ms" << slog::endl;
+        }
+        if (_failed > 0) {
+            slog::warn << "     Failed to write " << _failed << " frames" << slog::endl;
+        }
+    }
+
+private:
+    void run() {
+        typedef std::chrono::duration<double, std::ratio<1, 1000>> ms;
+        cv::Mat frame;
+        std::vector<char> name(_path.size() + 128);
+        while (_queue.pop(frame)) {
+            auto t0 = std::chrono::high_resolution_clock::now();
+            bool ok = true;
+            if (_imageSequence) {
+                std::snprintf(name.data(), name.size(), _path.c_str(), static_cast<int>(_written + _failed));
+                ok = cv::imwrite(name.data(), frame);
+            } else {
+                _video.write(frame);
+            }
+            auto t1 = std::chrono::high_resolution_clock::now();
+            _encodeMs += std::chrono::duration_cast<ms>(t1 - t0).count();
+            if (ok) {
+                _written++;
+            } else {
+                _failed++;
+            }
+        }
+    }
+
+    std::string _path;
+    BoundedQueue<cv::Mat> _queue;
+    const bool _imageSequence;
+    cv::VideoWriter _video;
+    std::thread _thread;
+
+    size_t _submitted = 0;
+    size_t _dropped = 0;
+    std::atomic<size_t> _written{0};
+    std::atomic<size_t> _failed{0};
+    double _encodeMs = 0;       // written by the writer thread, read after close() joined it
+};
@@ -0,0 +1,170 @@
+/*
+// Copyright (c) 2018 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma once
+
+#include <string>
+#include <vector>
+#include <map>
+#include <mutex>
+#include <ostream>
+#include <iomanip>
+#include <algorithm>
+#include <limits>
+
+#include <inference_engine.hpp>
+
+/**
+* \brief Accumulates the per-layer performance counters of every inference of a network.
+* Only layers that were executed are counted, times are in microseconds.
+* Safe to share between the infer requests of several threads.
+*/
+class PerfCounterAggregator {
+public:
+    struct LayerStats {
+        std::string layerType;
+        std::string execType;
+        unsigned executionIndex = 0;
+        size_t samples = 0;
+        long long minUs = std::numeric_limits<long long>::max();
+        long long maxUs = 0;
+        double totalUs = 0;
+        double totalCpuUs = 0;
+
+        double meanUs() const {
+            return samples ? totalUs / samples : 0;
+        }
+    };
+
+    void add(const std::map<std::string, InferenceEngine::InferenceEngineProfileInfo> &counters) {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _inferences++;
+        for (auto &&counter : counters) {
+            const InferenceEngine::InferenceEngineProfileInfo &info = counter.second;
+            if (info.status != InferenceEngine::InferenceEngineProfileInfo::EXECUTED) {
+                continue;
+            }
+            LayerStats &stats = _layers[counter.first];
+            if (stats.samples == 0) {
+                stats.layerType = info.layer_type;
+                stats.execType = info.exec_type;
+                stats.executionIndex = info.execution_index;
+            }
+            stats.samples++;
+            stats.minUs = std::min(stats.minUs, info.realTime_uSec);
+            stats.maxUs = std::max(stats.maxUs, info.realTime_uSec);
+            stats.totalUs += info.realTime_uSec;
+            stats.totalCpuUs += info.cpu_uSec;
+        }
+    }
+
+    size_t inferences() const {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return _inferences;
+    }
+
+    /** Prints all layers in execution order, followed by the topN layers with the largest total time **/
+    void print(std::ostream &stream, size_t topN) const {
+        std::lock_guard<std::mutex> lock(_mutex);
+        const std::vector<Entry> layers = sorted([](const Entry &a, const Entry &b) {
+            return a.second->executionIndex < b.second->executionIndex;
+        });
+        double totalUs = 0;
+        for (auto &&layer : layers) {
+            totalUs += layer.second->totalUs;
+        }
+
+        stream << _inferences << " inferences, " << std::fixed << std::setprecision(1)
+               << (_inferences ? totalUs / _inferences : 0.0) << " us per inference in executed layers" << std::endl;
+        stream << std::left << std::setw(40) << "layer" << std::setw(16) << "type" << std::setw(24) << "exec type"
+               << std::right << std::setw(10) << "min us" << std::setw(10) << "mean us" << std::setw(10) << "max us"
+               << std::setw(8) << "%" << std::endl;
+        for (auto &&layer : layers) {
+            printRow(stream, *layer.first, *layer.second, totalUs);
+        }
+
+        if (topN > 0 && !layers.empty()) {
+            const std::vector<Entry> hottest = sorted([](const Entry &a, const Entry &b) {
+                return a.second->totalUs > b.second->totalUs;
+            });
+            stream << std::endl << "Top " << std::min(topN, hottest.size()) << " layers by total time:" << std::endl;
+            for (size_t i = 0; i < std::min(topN, hottest.size()); i++) {
+                printRow(stream, *hottest[i].first, *hottest[i].second, totalUs);
+            }
+        }
+        stream << std::endl;
+    }
+
+    /** One CSV row per layer, see csvHeader for the columns **/
+    void writeCsv(std::ostream &stream, const std::string &network) const {
+        std::lock_guard<std::mutex> lock(_mutex);
+        for (auto &&layer : _layers) {
+            const LayerStats &stats = layer.second;
+            stream << '"' << network << "\",\"" << layer.first << "\"," << stats.layerType << ',' << stats.execType
+                   << ',' << stats.executionIndex << ',' << stats.samples << ',' << stats.minUs << ','
+                   << std::fixed << std::setprecision(2) << stats.meanUs() << ',' << stats.maxUs << ','
+                   << stats.totalUs << ',' << (stats.samples ? stats.totalCpuUs / stats.samples : 0.0) << '\n';
+        }
+    }
+
+    static const char *csvHeader() {
+        return "network,layer,layer_type,exec_type,execution_index,samples,min_us,mean_us,max_us,total_us,cpu_mean_us";
+    }
+
+    /** A JSON object with the number of inferences and an array of layers **/
+    void writeJson(std::ostream &stream) const {
+        std::lock_guard<std::mutex> lock(_mutex);
+        stream << "{\"inferences\":" << _inferences << ",\"layers\":[";
+        bool first = true;
+        for (auto &&layer : _layers) {
+            const LayerStats &stats = layer.second;
+            stream << (first ? "" : ",") << "\n    {\"layer\":\"" << layer.first << "\",\"layer_type\":\""
+                   << stats.layerType << "\",\"exec_type\":\"" << stats.execType << "\",\"execution_index\":"
+                   << stats.executionIndex << ",\"samples\":" << stats.samples << ",\"min_us\":" << stats.minUs
+                   << ",\"mean_us\":" << std::fixed << std::setprecision(2) << stats.meanUs()
+                   << ",\"max_us\":" << stats.maxUs << ",\"total_us\":" << stats.totalUs << "}";
+            first = false;
+        }
+        stream << "]}";
+    }
+
+private:
+    typedef std::pair<const std::string *, const LayerStats *> Entry;
+
+    template <typename Less>
+    std::vector<Entry> sorted(Less less) const {
+        std::vector<Entry> entries;
+        for (auto &&layer : _layers) {
+            entries.push_back(Entry(&layer.first, &layer.second));
+        }
+        std::stable_sort(entries.begin(), entries.end(), less);
+        return entries;
+    }
+
+    static void printRow(std::ostream &stream, const std::string &name, const LayerStats &stats, double totalUs) {
+        std::string shortName = name.size() > 38 ? name.substr(0, 35) + "..." : name;
+        stream << std::left << std::setw(40) << shortName << std::setw(16) << stats.layerType.substr(0, 15)
+               << std::setw(24) << stats.execType.substr(0, 23) << std::right << std::setw(10) << stats.minUs
+               << std::setw(10) << std::fixed << std::setprecision(1) << stats.meanUs() << std::setw(10) << stats.maxUs
+               << std::setw(8) << std::setprecision(2) << (totalUs > 0 ? 100.0 * stats.totalUs / totalUs : 0.0)
+               << std::endl;
+    }
+
+    mutable std::mutex _mutex;
+    size_t _inferences = 0;
+    std::map<std::string, LayerStats> _layers;
+};
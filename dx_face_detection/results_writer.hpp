@@ -0,0 +1,339 @@
+/*
+// Copyright (c) 2018 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma once
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <map>
+#include <thread>
+#include <stdexcept>
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <cerrno>
+#include <iomanip>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+#endif
+
+#include <opencv2/opencv.hpp>
+#include <samples/slog.hpp>
+
+#include "bounded_queue.hpp"
+
+/// @brief Results for one detected face; attribute values are valid only when the matching flag is set.
+/// Outputs of networks registered with -m_attr are kept by name in attributes.
+struct FaceRecord {
+    cv::Rect location;
+    float confidence = 0;
+    int label = 0;
+    bool hasAgeGender = false;
+    float age = 0;
+    float maleProb = 0;
+    bool hasHeadPose = false;
+    float yaw = 0;
+    float pitch = 0;
+    float roll = 0;
+    std::map<std::string, std::vector<float>> attributes;
+};
+
+/// @brief Results for one processed frame; source names the input image when frames come from a directory
+struct FrameRecord {
+    int64_t frameIndex = 0;
+    double timestampMs = 0;
+    std::string source;
+    std::vector<FaceRecord> faces;
+};
+
+/**
+* \brief Serializes frame records as JSON lines or as a compact binary stream.
+*
+* The binary stream starts with the "FDR1" magic, followed by the records:
+*   int64 frameIndex, double timestampMs, uint32 sourceLength, sourceLength characters of the
+*   source name, uint32 faceCount and per face
+*   int32 x, y, width, height, float confidence, int32 label, uint8 flags
+*   (bit 0 - age/gender, bit 1 - head pose, bit 2 - named attributes), float age, maleProb, yaw, pitch, roll.
+*   With bit 2 set the face continues with uint32 attributeCount and per attribute
+*   uint32 nameLength, nameLength characters, uint32 valueCount and valueCount floats.
+* All values use the host byte order.
+*/
+namespace ResultsFormat {
+
+static const char binaryMagic[4] = {'F', 'D', 'R', '1'};
+
+template <typename T>
+inline void appendRaw(std::string &out, const T &value) {
+    out.append(reinterpret_cast<const char *>(&value), sizeof(value));
+}
+
+inline void appendBinary(std::string &out, const FrameRecord &record) {
+    appendRaw(out, static_cast<int64_t>(record.frameIndex));
+    appendRaw(out, record.timestampMs);
+    appendRaw(out, static_cast<uint32_t>(record.source.size()));
+    out += record.source;
+    appendRaw(out, static_cast<uint32_t>(record.faces.size()));
+    for (auto &&face : record.faces) {
+        appendRaw(out, static_cast<int32_t>(face.location.x));
+        appendRaw(out, static_cast<int32_t>(face.location.y));
+        appendRaw(out, static_cast<int32_t>(face.location.width));
+        appendRaw(out, static_cast<int32_t>(face.location.height));
+        appendRaw(out, face.confidence);
+        appendRaw(out, static_cast<int32_t>(face.label));
+        appendRaw(out, static_cast<uint8_t>((face.hasAgeGender ? 1 : 0) | (face.hasHeadPose ? 2 : 0) |
+                                            (face.attributes.empty() ? 0 : 4)));
+        appendRaw(out, face.age);
+        appendRaw(out, face.maleProb);
+        appendRaw(out, face.yaw);
+        appendRaw(out, face.pitch);
+        appendRaw(out, face.roll);
+        if (face.attributes.empty()) {
+            continue;
+        }
+        appendRaw(out, static_cast<uint32_t>(face.attributes.size()));
+        for (auto &&attribute : face.attributes) {
+            appendRaw(out, static_cast<uint32_t>(attribute.first.size()));
+            out += attribute.first;
+            appendRaw(out, static_cast<uint32_t>(attribute.second.size()));
+            out.append(reinterpret_cast<const char *>(attribute.second.data()), attribute.second.size() * sizeof(float));
+        }
+    }
+}
+
+inline void appendJsonString(std::string &out, const std::string &value) {
+    out += '"';
+    for (char c : value) {
+        if (c == '"' || c == '\\') {
+            out += '\\';
+            out += c;
+        } else if (static_cast<unsigned char>(c) < 0x20) {
+            char escaped[8];
+            std::snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+            out += escaped;
+        } else {
+            out += c;
+        }
+    }
+    out += '"';
+}
+
+inline void appendJson(std::string &out, const FrameRecord &record) {
+    char buf[256];
+    std::snprintf(buf, sizeof(buf), "{\"frame\":%lld,\"ts\":%.3f,",
+                  static_cast<long long>(record.frameIndex), record.timestampMs);
+    out += buf;
+    if (!record.source.empty()) {
+        out += "\"src\":";
+        appendJsonString(out, record.source);
+        out += ',';
+    }
+    out += "\"faces\":[";
+    for (size_t i = 0; i < record.faces.size(); i++) {
+        const FaceRecord &face = record.faces[i];
+        std::snprintf(buf, sizeof(buf), "%s{\"x\":%d,\"y\":%d,\"w\":%d,\"h\":%d,\"conf\":%.4f,\"label\":%d",
+                      i ? "," : "", face.location.x, face.location.y, face.location.width, face.location.height,
+                      face.confidence, face.label);
+        out += buf;
+        if (face.hasAgeGender) {
+            std::snprintf(buf, sizeof(buf), ",\"age\":%.2f,\"male\":%.4f", face.age, face.maleProb);
+            out += buf;
+        }
+        if (face.hasHeadPose) {
+            std::snprintf(buf, sizeof(buf), ",\"yaw\":%.3f,\"pitch\":%.3f,\"roll\":%.3f", face.yaw, face.pitch, face.roll);
+            out += buf;
+        }
+        if (!face.attributes.empty()) {
+            out += ",\"attrs\":{";
+            bool firstAttribute = true;
+            for (auto &&attribute : face.attributes) {
+                out += firstAttribute ? "" : ",";
+                appendJsonString(out, attribute.first);
+                out += ":[";
+                for (size_t v = 0; v < attribute.second.size(); v++) {
+                    std::snprintf(buf, sizeof(buf), "%s%.6g", v ? "," : "", attribute.second[v]);
+                    out += buf;
+                }
+                out += ']';
+                firstAttribute = false;
+            }
+            out += '}';
+        }
+        out += '}';
+    }
+    out += "]}\n";
+}
+
+}  // namespace ResultsFormat
+
+/**
+* \brief Streams frame records to a file or, with a "unix:" prefix, to a Unix domain socket.
+* Records are serialized and written by a background thread, one write() per drained batch,
+* so the inference loop only pays for a queue push. When the consumer falls behind and the queue fills up,
+* push() either waits for it (the default, every record reaches the output) or, with dropWhenFull,
+* drops and counts the record like AsyncFrameWriter does, so a slow reader cannot stall inference.
+*/
+class ResultsWriter {
+public:
+    ResultsWriter(const std::string &path, const std::string &format, bool dropWhenFull = false, size_t queueSize = 256)
+        : _path(path), _binary(format == "bin"), _dropWhenFull(dropWhenFull), _queue(queueSize) {
+        if (format != "bin" && format != "jsonl") {
+            throw std::logic_error("Unknown results format: " + format + ", should be jsonl or bin");
+        }
+#ifdef _WIN32
+        throw std::logic_error("Structured results output is not supported on Windows");
+#else
+        const std::string socketPrefix = "unix:";
+        if (path.compare(0, socketPrefix.size(), socketPrefix) == 0) {
+            const std::string socketPath = path.substr(socketPrefix.size());
+            sockaddr_un addr;
+            std::memset(&addr, 0, sizeof(addr));
+            addr.sun_family = AF_UNIX;
+            if (socketPath.size() >= sizeof(addr.sun_path)) {
+                throw std::logic_error("Unix socket path is too long: " + socketPath);
+            }
+            std::strncpy(addr.sun_path, socketPath.c_str(), sizeof(addr.sun_path) - 1);
+            _socket = true;
+            _fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+            if (_fd < 0 || ::connect(_fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) != 0) {
+                closeFd();
+                throw std::logic_error("Cannot connect to results socket " + socketPath + ": " + std::strerror(errno));
+            }
+        } else {
+            _fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+            if (_fd < 0) {
+                throw std::logic_error("Cannot open results file " + path + ": " + std::strerror(errno));
+            }
+        }
+        if (_binary) {
+            writeAll(std::string(ResultsFormat::binaryMagic, sizeof(ResultsFormat::binaryMagic)));
+        }
+        _thread = std::thread(&ResultsWriter::run, this);
+#endif
+    }
+
+    ~ResultsWriter() {
+        close();
+    }
+
+    /** Blocks only when the queue is full, unless full queues drop records **/
+    void push(FrameRecord record) {
+        _submitted++;
+        if (_dropWhenFull) {
+            if (!_queue.tryPush(std::move(record))) {
+                _dropped++;
+            }
+        } else {
+            _queue.push(std::move(record));
+        }
+    }
+
+    void close() {
+        if (_thread.joinable()) {
+            _queue.close();
+            _thread.join();
+        }
+        closeFd();
+    }
+
+    /** Only valid after close(), the writer thread updates the counters without synchronization **/
+    void printStatistics() const {
+        slog::info << "Results writer (" << _path << "): " << _records << " records, " << _bytes << " bytes in "
+                   << _writes << " writes";
+        if (_writes > 0) {
+            slog::info << " (" << std::fixed << std::setprecision(1) << static_cast<double>(_records) / _writes
+                       << " records per write)";
+        }
+        slog::info << slog::endl;
+        if (_dropped > 0) {
+            slog::warn << "     Dropped " << _dropped << " of " << _submitted << " records, the results consumer "
+                       << "could not keep up" << slog::endl;
+        }
+        if (_failed) {
+            slog::warn << "     Results output failed, some records were lost" << slog::endl;
+        }
+    }
+
+private:
+    void run() {
+        std::deque<FrameRecord> batch;
+        std::string buffer;
+        while (_queue.popAll(batch)) {
+            buffer.clear();
+            for (auto &&record : batch) {
+                if (_binary) {
+                    ResultsFormat::appendBinary(buffer, record);
+                } else {
+                    ResultsFormat::appendJson(buffer, record);
+                }
+            }
+            _records += batch.size();
+            writeAll(buffer);
+        }
+    }
+
+    void writeAll(const std::string &data) {
+#ifndef _WIN32
+        const char *ptr = data.data();
+        size_t left = data.size();
+        while (left > 0 && !_failed) {
+            // a vanished reader must not kill the pipeline with SIGPIPE
+            ssize_t written = _socket ? ::send(_fd, ptr, left, MSG_NOSIGNAL) : ::write(_fd, ptr, left);
+            if (written < 0) {
+                if (errno == EINTR) continue;
+                _failed = true;
+                break;
+            }
+            ptr += written;
+            left -= written;
+        }
+        _bytes += data.size() - left;
+        _writes++;
+#endif
+    }
+
+    void closeFd() {
+#ifndef _WIN32
+        if (_fd >= 0) {
+            ::close(_fd);
+            _fd = -1;
+        }
+#endif
+    }
+
+    std::string _path;
+    const bool _binary;
+    const bool _dropWhenFull;
+    BoundedQueue<FrameRecord> _queue;
+    std::thread _thread;
+    int _fd = -1;
+    bool _socket = false;
+
+    size_t _submitted = 0;
+    size_t _dropped = 0;
+    size_t _records = 0;
+    size_t _bytes = 0;
+    size_t _writes = 0;
+    bool _failed = false;
+};
@@ -0,0 +1,90 @@
+/*
+// Copyright (c) 2018 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma once
+
+/**
+* \brief Layout of the POSIX shared memory ring used to pass decoded BGR frames between processes.
+*
+* The segment starts with a ShmRingHeader, followed by slotCount slots of slotSize bytes each,
+* the first one at dataOffset. Every slot begins with a ShmSlotHeader, the pixels follow at
+* ShmRingLayout::pixelOffset with the row stride given in the ring header.
+*
+* The producer writes frame number N (starting at 1) into slot N % slotCount:
+*   1. slot.sequence = 0, the slot is being written
+*   2. copy the pixels, set slot.timestampMs
+*   3. slot.sequence = N, then ring.writeSequence = N
+* A consumer reads ring.writeSequence, uses the slot while slot.sequence still equals N and
+* reports a gap whenever N jumps by more than one. There is a single producer per ring.
+*/
+
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+
+static const uint32_t shmRingMagic = 0x4d534446;  // "FDSM"
+static const uint32_t shmRingVersion = 1;
+
+struct ShmRingHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t width;
+    uint32_t height;
+    uint32_t stride;            // bytes per row, at least width * 3
+    uint32_t slotCount;
+    uint64_t slotSize;          // bytes per slot, including the slot header
+    uint64_t dataOffset;        // offset of the first slot from the start of the segment
+    double fps;                 // nominal source frame rate, 0 if unknown
+    std::atomic<uint64_t> writeSequence;  // last completely written frame, 0 if none yet
+    std::atomic<uint32_t> producerClosed; // set to 1 once the producer will not write anymore
+};
+
+struct ShmSlotHeader {
+    std::atomic<uint64_t> sequence;  // frame number held by the slot, 0 while it is being written
+    double timestampMs;              // capture time reported by the producer
+};
+
+namespace ShmRingLayout {
+
+static const size_t alignment = 64;
+
+inline size_t alignUp(size_t value) {
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+inline size_t pixelOffset() {
+    return alignUp(sizeof(ShmSlotHeader));
+}
+
+inline size_t slotSize(uint32_t stride, uint32_t height) {
+    return alignUp(pixelOffset() + static_cast<size_t>(stride) * height);
+}
+
+inline size_t segmentSize(uint32_t stride, uint32_t height, uint32_t slotCount) {
+    return alignUp(sizeof(ShmRingHeader)) + slotSize(stride, height) * slotCount;
+}
+
+inline ShmSlotHeader *slot(ShmRingHeader *ring, uint64_t sequence) {
+    uint8_t *base = reinterpret_cast<uint8_t *>(ring) + ring->dataOffset;
+    return reinterpret_cast<ShmSlotHeader *>(base + (sequence % ring->slotCount) * ring->slotSize);
+}
+
+inline uint8_t *pixels(ShmSlotHeader *slot) {
+    return reinterpret_cast<uint8_t *>(slot) + pixelOffset();
+}
+
+}  // namespace ShmRingLayout
@@ -0,0 +1,127 @@
+/*
+// Copyright (c) 2018 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma once
+
+#include <vector>
+#include <iomanip>
+
+#include <opencv2/opencv.hpp>
+#include <samples/slog.hpp>
+
+#include "results_writer.hpp"
+#include "box_utils.hpp"
+
+/** Copies everything the second stage networks found out about a face, but not where it is **/
+inline void copyFaceAttributes(const FaceRecord &from, FaceRecord &to) {
+    to.hasAgeGender = from.hasAgeGender;
+    to.age = from.age;
+    to.maleProb = from.maleProb;
+    to.hasHeadPose = from.hasHeadPose;
+    to.yaw = from.yaw;
+    to.pitch = from.pitch;
+    to.roll = from.roll;
+    to.attributes = from.attributes;
+}
+
+/**
+* \brief Speculative second stage: predicts where the faces of the last frame are in the next one, so their
+* attributes can be inferred on the new frame while the detector still runs on it. Once the detections are
+* there, resolve() keeps the speculative attributes of every detection that overlaps a prediction by at
+* least minIou and lists the detections that still need the second stage.
+*/
+class FaceSpeculation {
+public:
+    explicit FaceSpeculation(float minIou) : _minIou(minIou) {}
+
+    /** Faces of the last frame moved by their motion since the frame before, clipped to the frame **/
+    std::vector<FaceRecord> predict(const cv::Size &frameSize) const {
+        std::vector<FaceRecord> predicted;
+        const cv::Rect frame(0, 0, frameSize.width, frameSize.height);
+        for (size_t i = 0; i < _faces.size(); i++) {
+            FaceRecord face;
+            face.location = (_faces[i] + _motion[i]) & frame;
+            if (face.location.area() > 0) {
+                predicted.push_back(face);
+            }
+        }
+        return predicted;
+    }
+
+    /**
+    * \brief Takes the attributes of matching speculative faces over into the detected faces and returns
+    * the indices of the detected faces without a match. Remembers the detections for the next prediction.
+    */
+    std::vector<size_t> resolve(const std::vector<FaceRecord> &speculative, std::vector<FaceRecord> &faces) {
+        std::vector<cv::Rect> detected, predicted;
+        for (auto &&face : faces) {
+            detected.push_back(face.location);
+        }
+        for (auto &&face : speculative) {
+            predicted.push_back(face.location);
+        }
+
+        std::vector<bool> hit(faces.size(), false);
+        for (auto &&match : matchBoxes(detected, predicted, _minIou)) {
+            copyFaceAttributes(speculative[match.second], faces[match.first]);
+            hit[match.first] = true;
+            _hits++;
+        }
+        std::vector<size_t> misses;
+        for (size_t i = 0; i < faces.size(); i++) {
+            if (!hit[i]) {
+                misses.push_back(i);
+            }
+        }
+        _frames++;
+        _predicted += speculative.size();
+        _detected += faces.size();
+
+        // a face keeps moving like it did between its last two detections
+        std::vector<cv::Point> motion(detected.size());
+        for (auto &&match : matchBoxes(detected, _faces, trackingIou)) {
+            motion[match.first] = detected[match.first].tl() - _faces[match.second].tl();
+        }
+        _faces = detected;
+        _motion = motion;
+        return misses;
+    }
+
+    void printStatistics() const {
+        if (_frames == 0) {
+            return;
+        }
+        slog::info << "   Speculative second stage: " << _hits << " of " << _detected << " detected faces took the "
+                   << "attributes inferred on predicted boxes (" << std::fixed << std::setprecision(1)
+                   << (_detected ? 100.0 * _hits / _detected : 0.0) << "% hit rate at IoU >= " << _minIou << ")" << slog::endl;
+        slog::info << "     " << _detected - _hits << " faces were inferred again after detection, "
+                   << _predicted - _hits << " of " << _predicted << " predicted boxes were wasted" << slog::endl;
+    }
+
+private:
+    /** Loose overlap that still takes a detection for the same face as in the last frame **/
+    static constexpr float trackingIou = 0.2f;
+
+    const float _minIou;
+    std::vector<cv::Rect> _faces;
+    std::vector<cv::Point> _motion;
+
+    size_t _frames = 0;
+    size_t _predicted = 0;
+    size_t _detected = 0;
+    size_t _hits = 0;
+};
@@ -0,0 +1,21 @@
+# Copyright (c) 2018 Intel Corporation
+
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+
+#      http://www.apache.org/licenses/LICENSE-2.0
+
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+
+# Runs results_compare on REFERENCE and CANDIDATE and fails unless it exits with EXPECTED,
+# so a drifting pair has to be reported as a failure (1) and not as an error (2)
+#   cmake -DCHECKER=<results_compare> -DREFERENCE=<jsonl> -DCANDIDATE=<jsonl> -DEXPECTED=<code> -P expect_exit_code.cmake
+execute_process(COMMAND ${CHECKER} ${REFERENCE} ${CANDIDATE} RESULT_VARIABLE result)
+if(NOT "${result}" STREQUAL "${EXPECTED}")
+    message(FATAL_ERROR "results_compare ${REFERENCE} ${CANDIDATE} exited with ${result}, expected ${EXPECTED}")
+endif()
@@ -0,0 +1,39 @@
+# Copyright (c) 2018 Intel Corporation
+
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+
+#      http://www.apache.org/licenses/LICENSE-2.0
+
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+
+# Runs face_detection_tutorial -ro on CLIP and checks the results against GOLDEN with results_compare.
+# AG_MODEL, HP_MODEL, DEVICE, EXTRA_ARGS and COMPARE_ARGS are optional, the argument lists are space separated.
+set(args -i ${CLIP} -m ${MODEL} -no_show -no_wait -ro ${CANDIDATE})
+if(AG_MODEL)
+    list(APPEND args -m_ag ${AG_MODEL})
+endif()
+if(HP_MODEL)
+    list(APPEND args -m_hp ${HP_MODEL})
+endif()
+if(DEVICE)
+    list(APPEND args -d ${DEVICE})
+endif()
+separate_arguments(extraArgs UNIX_COMMAND "${EXTRA_ARGS}")
+separate_arguments(compareArgs UNIX_COMMAND "${COMPARE_ARGS}")
+
+file(REMOVE ${CANDIDATE})
+execute_process(COMMAND ${TUTORIAL} ${args} ${extraArgs} RESULT_VARIABLE result)
+if(NOT result EQUAL 0)
+    message(FATAL_ERROR "face_detection_tutorial exited with ${result}")
+endif()
+
+execute_process(COMMAND ${CHECKER} ${GOLDEN} ${CANDIDATE} ${compareArgs} RESULT_VARIABLE result)
+if(NOT result EQUAL 0)
+    message(FATAL_ERROR "Results of ${CLIP} differ from ${GOLDEN} (results_compare exited with ${result})")
+endif()
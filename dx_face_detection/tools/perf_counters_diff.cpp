@@ -0,0 +1,177 @@
+/*
+// Copyright (c) 2018 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+
+/**
+* \brief Compares two per-layer performance reports written by face_detection_tutorial -pc_out.
+*
+* Usage: perf_counters_diff <baseline.csv> <candidate.csv> [top N]
+* Layers are matched by network and layer name and listed by the largest change of mean time.
+* Layers present in only one of the runs (e.g. fused differently by a new plugin) are listed separately.
+*/
+#include <iostream>
+#include <fstream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <map>
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+struct LayerRow {
+    std::string layerType;
+    std::string execType;
+    double meanUs = 0;
+    size_t samples = 0;
+};
+
+typedef std::pair<std::string, std::string> LayerKey;  // network, layer
+
+static std::vector<std::string> splitCsvLine(const std::string &line) {
+    std::vector<std::string> fields;
+    std::string field;
+    bool quoted = false;
+    for (char c : line) {
+        if (c == '"') {
+            quoted = !quoted;
+        } else if (c == ',' && !quoted) {
+            fields.push_back(field);
+            field.clear();
+        } else {
+            field += c;
+        }
+    }
+    fields.push_back(field);
+    return fields;
+}
+
+static std::map<LayerKey, LayerRow> readReport(const std::string &path) {
+    std::ifstream file(path);
+    if (!file) {
+        throw std::runtime_error("Cannot open " + path);
+    }
+    std::string line;
+    std::getline(file, line);
+    const std::vector<std::string> header = splitCsvLine(line);
+    auto column = [&](const std::string &name) -> size_t {
+        auto it = std::find(header.begin(), header.end(), name);
+        if (it == header.end()) {
+            throw std::runtime_error(path + " has no " + name + " column");
+        }
+        return it - header.begin();
+    };
+    const size_t networkCol = column("network"), layerCol = column("layer"), typeCol = column("layer_type"),
+                 execCol = column("exec_type"), samplesCol = column("samples"), meanCol = column("mean_us");
+
+    std::map<LayerKey, LayerRow> rows;
+    while (std::getline(file, line)) {
+        if (line.empty()) continue;
+        std::vector<std::string> fields = splitCsvLine(line);
+        if (fields.size() < header.size()) {
+            throw std::runtime_error(path + " has a malformed line: " + line);
+        }
+        LayerRow row;
+        row.layerType = fields[typeCol];
+        row.execType = fields[execCol];
+        row.samples = std::stoul(fields[samplesCol]);
+        row.meanUs = std::stod(fields[meanCol]);
+        rows[LayerKey(fields[networkCol], fields[layerCol])] = row;
+    }
+    return rows;
+}
+
+int main(int argc, char *argv[]) {
+    if (argc < 3) {
+        std::cerr << "Usage: " << argv[0] << " <baseline.csv> <candidate.csv> [top N]" << std::endl;
+        return 1;
+    }
+    try {
+        const auto baseline = readReport(argv[1]);
+        const auto candidate = readReport(argv[2]);
+        const size_t topN = argc > 3 ? std::stoul(argv[3]) : 20;
+
+        struct Change {
+            LayerKey key;
+            double baseUs;
+            double newUs;
+            std::string execTypes;
+        };
+        std::vector<Change> changes;
+        std::vector<LayerKey> onlyBaseline, onlyCandidate;
+        std::map<std::string, std::pair<double, double>> networkTotals;
+
+        for (auto &&row : baseline) {
+            networkTotals[row.first.first].first += row.second.meanUs;
+            auto other = candidate.find(row.first);
+            if (other == candidate.end()) {
+                onlyBaseline.push_back(row.first);
+                continue;
+            }
+            std::string execTypes = row.second.execType == other->second.execType
+                ? row.second.execType : row.second.execType + " -> " + other->second.execType;
+            changes.push_back({row.first, row.second.meanUs, other->second.meanUs, execTypes});
+        }
+        for (auto &&row : candidate) {
+            networkTotals[row.first.first].second += row.second.meanUs;
+            if (baseline.find(row.first) == baseline.end()) {
+                onlyCandidate.push_back(row.first);
+            }
+        }
+
+        std::cout << std::fixed << std::setprecision(1);
+        std::cout << "Mean time per inference summed over executed layers:" << std::endl;
+        for (auto &&total : networkTotals) {
+            const double base = total.second.first, next = total.second.second;
+            std::cout << "  " << std::left << std::setw(20) << total.first << std::right << std::setw(12) << base
+                      << " us -> " << std::setw(12) << next << " us";
+            if (next > 0) {
+                std::cout << "  (" << std::setprecision(2) << base / next << "x)" << std::setprecision(1);
+            }
+            std::cout << std::endl;
+        }
+
+        std::sort(changes.begin(), changes.end(), [](const Change &a, const Change &b) {
+            return std::fabs(a.newUs - a.baseUs) > std::fabs(b.newUs - b.baseUs);
+        });
+        std::cout << std::endl << "Largest changes of mean layer time (us):" << std::endl;
+        std::cout << std::left << std::setw(18) << "network" << std::setw(40) << "layer" << std::right
+                  << std::setw(10) << "baseline" << std::setw(10) << "candidate" << std::setw(10) << "delta"
+                  << "  exec type" << std::endl;
+        for (size_t i = 0; i < std::min(topN, changes.size()); i++) {
+            const Change &change = changes[i];
+            std::string layer = change.key.second.size() > 38 ? change.key.second.substr(0, 35) + "..." : change.key.second;
+            std::cout << std::left << std::setw(18) << change.key.first.substr(0, 17) << std::setw(40) << layer
+                      << std::right << std::setw(10) << change.baseUs << std::setw(10) << change.newUs
+                      << std::setw(10) << std::showpos << change.newUs - change.baseUs << std::noshowpos
+                      << "  " << change.execTypes << std::endl;
+        }
+
+        auto printOnly = [&](const char *title, const std::vector<LayerKey> &keys, const std::map<LayerKey, LayerRow> &rows) {
+            if (keys.empty()) return;
+            std::cout << std::endl << title << " (" << keys.size() << "):" << std::endl;
+            for (auto &&key : keys) {
+                std::cout << "  " << key.first << " / " << key.second << "  " << rows.at(key).layerType
+                          << ", " << rows.at(key).meanUs << " us" << std::endl;
+            }
+        };
+        printOnly("Layers only in the baseline", onlyBaseline, baseline);
+        printOnly("Layers only in the candidate", onlyCandidate, candidate);
+    } catch (const std::exception &error) {
+        std::cerr << error.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
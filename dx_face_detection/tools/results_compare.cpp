@@ -0,0 +1,376 @@
+/*
+// Copyright (c) 2018 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+
+/**
+* \brief Checks structured results of face_detection_tutorial against golden reference results.
+*
+* Record the reference once and compare every later run of the same clip with it:
+*   face_detection_tutorial -i clip.mp4 <models> -no_show -no_wait -ro golden.jsonl
+*   face_detection_tutorial -i clip.mp4 <models> -no_show -no_wait -ro candidate.jsonl
+*   results_compare golden.jsonl candidate.jsonl [-iou 0.5] [-conf 0.05] [-age 2] [-male 0.1] [-angle 3] [-attr 0.01]
+*
+* Frames are paired by source name (image directories) or frame index, faces by the highest IoU.
+* A frame only in one file, a face without a partner at -iou, a gender flip or any difference above
+* its tolerance is a failure. Exit code is 0 when all frames match, 1 on failures and 2 on errors.
+*
+* ctest runs both steps as golden_results_regression once the FD_REGRESSION_CLIP, FD_REGRESSION_MODEL
+* and FD_REGRESSION_GOLDEN cache variables are set, see tools/CMakeLists.txt.
+*/
+#include <iostream>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <map>
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cctype>
+#include <stdexcept>
+
+/** Just enough JSON for the -ro jsonl records: objects, arrays, strings, numbers **/
+struct JsonValue {
+    enum Type { Null, Number, String, Array, Object } type = Null;
+    double number = 0;
+    std::string string;
+    std::vector<JsonValue> array;
+    std::map<std::string, JsonValue> object;
+
+    const JsonValue *find(const std::string &key) const {
+        auto it = object.find(key);
+        return it == object.end() ? nullptr : &it->second;
+    }
+    double numberOr(const std::string &key, double fallback) const {
+        const JsonValue *value = find(key);
+        return value && value->type == Number ? value->number : fallback;
+    }
+};
+
+class JsonParser {
+public:
+    explicit JsonParser(const std::string &text) : _text(text) {}
+
+    JsonValue parse() {
+        JsonValue value = parseValue();
+        skipSpace();
+        if (_pos != _text.size()) fail("trailing characters");
+        return value;
+    }
+
+private:
+    void fail(const std::string &what) const {
+        throw std::runtime_error("JSON " + what + " at offset " + std::to_string(_pos));
+    }
+    void skipSpace() {
+        while (_pos < _text.size() && std::isspace(static_cast<unsigned char>(_text[_pos]))) _pos++;
+    }
+    char peek() {
+        skipSpace();
+        if (_pos >= _text.size()) fail("ends too early");
+        return _text[_pos];
+    }
+    void expect(char c) {
+        if (peek() != c) fail(std::string("expects '") + c + "'");
+        _pos++;
+    }
+
+    JsonValue parseValue() {
+        JsonValue value;
+        const char c = peek();
+        if (c == '{') {
+            value.type = JsonValue::Object;
+            _pos++;
+            if (peek() == '}') { _pos++; return value; }
+            do {
+                std::string key = parseString();
+                expect(':');
+                value.object[key] = parseValue();
+            } while (peek() == ',' && ++_pos);
+            expect('}');
+        } else if (c == '[') {
+            value.type = JsonValue::Array;
+            _pos++;
+            if (peek() == ']') { _pos++; return value; }
+            do {
+                value.array.push_back(parseValue());
+            } while (peek() == ',' && ++_pos);
+            expect(']');
+        } else if (c == '"') {
+            value.type = JsonValue::String;
+            value.string = parseString();
+        } else if (_text.compare(_pos, 4, "null") == 0) {
+            _pos += 4;
+        } else {
+            const char *begin = _text.c_str() + _pos;
+            char *end = nullptr;
+            value.type = JsonValue::Number;
+            value.number = std::strtod(begin, &end);
+            if (end == begin) fail("has an unexpected character");
+            _pos += end - begin;
+        }
+        return value;
+    }
+
+    std::string parseString() {
+        expect('"');
+        std::string result;
+        while (_pos < _text.size() && _text[_pos] != '"') {
+            char c = _text[_pos++];
+            if (c == '\\' && _pos < _text.size()) {
+                c = _text[_pos++];
+                if (c == 'u' && _pos + 4 <= _text.size()) {
+                    result += static_cast<char>(std::strtol(_text.substr(_pos, 4).c_str(), nullptr, 16));
+                    _pos += 4;
+                    continue;
+                }
+                c = c == 'n' ? '\n' : c == 't' ? '\t' : c;
+            }
+            result += c;
+        }
+        expect('"');
+        return result;
+    }
+
+    const std::string &_text;
+    size_t _pos = 0;
+};
+
+struct Face {
+    double x = 0, y = 0, w = 0, h = 0, conf = 0;
+    const JsonValue *json = nullptr;
+};
+
+struct Frame {
+    std::string key;
+    JsonValue json;
+    std::vector<Face> faces;
+};
+
+static std::vector<Frame> readResults(const std::string &path) {
+    std::ifstream file(path);
+    if (!file) {
+        throw std::runtime_error("Cannot open " + path);
+    }
+    std::vector<Frame> frames;
+    std::string line;
+    size_t lineNumber = 0;
+    while (std::getline(file, line)) {
+        lineNumber++;
+        if (line.empty()) continue;
+        Frame frame;
+        try {
+            frame.json = JsonParser(line).parse();
+        } catch (const std::exception &error) {
+            throw std::runtime_error(path + ":" + std::to_string(lineNumber) + ": " + error.what());
+        }
+        const JsonValue *src = frame.json.find("src");
+        frame.key = src ? src->string : "frame " + std::to_string(static_cast<long long>(frame.json.numberOr("frame", -1)));
+        frames.push_back(std::move(frame));
+    }
+    // faces point into the JSON of their frame, which no longer moves
+    for (auto &&frame : frames) {
+        const JsonValue *faces = frame.json.find("faces");
+        if (!faces) continue;
+        for (auto &&faceJson : faces->array) {
+            Face face;
+            face.x = faceJson.numberOr("x", 0);
+            face.y = faceJson.numberOr("y", 0);
+            face.w = faceJson.numberOr("w", 0);
+            face.h = faceJson.numberOr("h", 0);
+            face.conf = faceJson.numberOr("conf", 0);
+            face.json = &faceJson;
+            frame.faces.push_back(face);
+        }
+    }
+    return frames;
+}
+
+static double iou(const Face &a, const Face &b) {
+    const double w = std::min(a.x + a.w, b.x + b.w) - std::max(a.x, b.x);
+    const double h = std::min(a.y + a.h, b.y + b.h) - std::max(a.y, b.y);
+    const double intersection = w > 0 && h > 0 ? w * h : 0;
+    const double unionArea = a.w * a.h + b.w * b.h - intersection;
+    return unionArea > 0 ? intersection / unionArea : 0;
+}
+
+struct Tolerances {
+    double iou = 0.5;
+    double conf = 0.05;
+    double age = 2.0;
+    double male = 0.1;
+    double angle = 3.0;
+    double attr = 0.01;
+};
+
+class Checker {
+public:
+    explicit Checker(const Tolerances &tolerances) : _tol(tolerances) {}
+
+    void compareFrames(const Frame &reference, const Frame &candidate) {
+        _frames++;
+        std::vector<std::pair<double, std::pair<size_t, size_t>>> candidates;
+        for (size_t i = 0; i < reference.faces.size(); i++) {
+            for (size_t j = 0; j < candidate.faces.size(); j++) {
+                const double overlap = iou(reference.faces[i], candidate.faces[j]);
+                if (overlap >= _tol.iou) candidates.push_back(std::make_pair(overlap, std::make_pair(i, j)));
+            }
+        }
+        std::stable_sort(candidates.begin(), candidates.end(),
+                         [](const std::pair<double, std::pair<size_t, size_t>> &a,
+                            const std::pair<double, std::pair<size_t, size_t>> &b) { return a.first > b.first; });
+        std::vector<bool> usedRef(reference.faces.size(), false), usedCand(candidate.faces.size(), false);
+        for (auto &&match : candidates) {
+            const size_t i = match.second.first, j = match.second.second;
+            if (usedRef[i] || usedCand[j]) continue;
+            usedRef[i] = usedCand[j] = true;
+            _faces++;
+            compareFaces(reference.key + " face " + std::to_string(i), reference.faces[i], candidate.faces[j]);
+        }
+        for (size_t i = 0; i < usedRef.size(); i++) {
+            if (!usedRef[i]) failure(reference.key, "reference face " + std::to_string(i) + " not found in candidate");
+        }
+        for (size_t j = 0; j < usedCand.size(); j++) {
+            if (!usedCand[j]) failure(reference.key, "candidate face " + std::to_string(j) + " not in reference");
+        }
+    }
+
+    void failure(const std::string &where, const std::string &what) {
+        if (_failures++ < maxPrinted) {
+            std::cout << "FAIL " << where << ": " << what << std::endl;
+        }
+    }
+
+    void printSummary() const {
+        if (_failures > maxPrinted) {
+            std::cout << "... " << _failures - maxPrinted << " more failures" << std::endl;
+        }
+        std::cout << (_failures ? "FAILED: " : "PASSED: ") << _frames << " frames and " << _faces
+                  << " matched faces compared, " << _failures << " failures" << std::endl;
+        std::cout << std::fixed << std::setprecision(4) << "Largest differences: conf " << _maxDiff.at("conf")
+                  << ", age " << _maxDiff.at("age") << ", male " << _maxDiff.at("male") << ", angle "
+                  << _maxDiff.at("angle") << ", attr " << _maxDiff.at("attr") << std::endl;
+    }
+
+    bool passed() const {
+        return _failures == 0;
+    }
+
+private:
+    static const size_t maxPrinted = 50;
+
+    void check(const std::string &where, const std::string &name, const std::string &kind, double reference,
+               double candidate, double tolerance) {
+        const double difference = std::fabs(reference - candidate);
+        _maxDiff[kind] = std::max(_maxDiff[kind], difference);
+        if (difference > tolerance) {
+            std::ostringstream what;
+            what << name << " " << reference << " -> " << candidate << " (tolerance " << tolerance << ")";
+            failure(where, what.str());
+        }
+    }
+
+    void compareFaces(const std::string &where, const Face &reference, const Face &candidate) {
+        check(where, "conf", "conf", reference.conf, candidate.conf, _tol.conf);
+        const JsonValue &ref = *reference.json, &cand = *candidate.json;
+        if ((ref.find("age") != nullptr) != (cand.find("age") != nullptr)) {
+            failure(where, "age gender present in only one of the results");
+        } else if (ref.find("age")) {
+            check(where, "age", "age", ref.numberOr("age", 0), cand.numberOr("age", 0), _tol.age);
+            check(where, "male", "male", ref.numberOr("male", 0), cand.numberOr("male", 0), _tol.male);
+            if ((ref.numberOr("male", 0) > 0.5) != (cand.numberOr("male", 0) > 0.5)) {
+                failure(where, "gender flipped");
+            }
+        }
+        if ((ref.find("yaw") != nullptr) != (cand.find("yaw") != nullptr)) {
+            failure(where, "head pose present in only one of the results");
+        } else if (ref.find("yaw")) {
+            for (const char *angle : {"yaw", "pitch", "roll"}) {
+                check(where, angle, "angle", ref.numberOr(angle, 0), cand.numberOr(angle, 0), _tol.angle);
+            }
+        }
+        const JsonValue *refAttrs = ref.find("attrs"), *candAttrs = cand.find("attrs");
+        if (!refAttrs && !candAttrs) return;
+        if (!refAttrs || !candAttrs) {
+            failure(where, "attributes present in only one of the results");
+            return;
+        }
+        for (auto &&attribute : refAttrs->object) {
+            const JsonValue *other = candAttrs->find(attribute.first);
+            if (!other || other->array.size() != attribute.second.array.size()) {
+                failure(where, "attribute " + attribute.first + " missing or of a different size in candidate");
+                continue;
+            }
+            for (size_t v = 0; v < attribute.second.array.size(); v++) {
+                check(where, attribute.first + "[" + std::to_string(v) + "]", "attr",
+                      attribute.second.array[v].number, other->array[v].number, _tol.attr);
+            }
+        }
+    }
+
+    const Tolerances _tol;
+    size_t _frames = 0;
+    size_t _faces = 0;
+    size_t _failures = 0;
+    std::map<std::string, double> _maxDiff = {{"conf", 0}, {"age", 0}, {"male", 0}, {"angle", 0}, {"attr", 0}};
+};
+
+int main(int argc, char *argv[]) {
+    if (argc < 3 || (argc - 3) % 2 != 0) {
+        std::cerr << "Usage: " << argv[0] << " <reference.jsonl> <candidate.jsonl> [-iou <min>] [-conf <delta>]"
+                  << " [-age <years>] [-male <delta>] [-angle <degrees>] [-attr <delta>]" << std::endl;
+        return 2;
+    }
+    try {
+        Tolerances tolerances;
+        std::map<std::string, double *> options = {
+            {"-iou", &tolerances.iou}, {"-conf", &tolerances.conf}, {"-age", &tolerances.age},
+            {"-male", &tolerances.male}, {"-angle", &tolerances.angle}, {"-attr", &tolerances.attr}};
+        for (int i = 3; i < argc; i += 2) {
+            auto option = options.find(argv[i]);
+            if (option == options.end()) {
+                throw std::runtime_error(std::string("Unknown option ") + argv[i]);
+            }
+            *option->second = std::stod(argv[i + 1]);
+        }
+
+        const std::vector<Frame> reference = readResults(argv[1]);
+        const std::vector<Frame> candidate = readResults(argv[2]);
+        std::map<std::string, const Frame *> candidateFrames;
+        for (auto &&frame : candidate) {
+            candidateFrames[frame.key] = &frame;
+        }
+
+        Checker checker(tolerances);
+        for (auto &&frame : reference) {
+            auto other = candidateFrames.find(frame.key);
+            if (other == candidateFrames.end()) {
+                checker.failure(frame.key, "missing in candidate");
+                continue;
+            }
+            checker.compareFrames(frame, *other->second);
+            candidateFrames.erase(other);
+        }
+        for (auto &&frame : candidateFrames) {
+            checker.failure(frame.first, "not in reference");
+        }
+        checker.printSummary();
+        return checker.passed() ? 0 : 1;
+    } catch (const std::exception &error) {
+        std::cerr << error.what() << std::endl;
+        return 2;
+    }
+}
@@ -0,0 +1,155 @@
+/*
+// Copyright (c) 2018 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+
+/**
+* \brief Publishes decoded frames of a video file or camera into a shared memory ring,
+* so face_detection_tutorial -i shm:<name> can be tried without a separate capture process.
+*
+* Usage: shm_frame_producer <video file|cam> <shm name, e.g. /fd_frames> [slots] [fps] [loops]
+*   slots - number of frames in the ring, at least 1 (default 4)
+*   fps   - publishing rate, 0 publishes as fast as frames decode (default is the source rate)
+*   loops - how many times a video file is played (default 1)
+*/
+#include <iostream>
+#include <string>
+#include <cstring>
+#include <cerrno>
+#include <cstdlib>
+#include <cstdint>
+#include <chrono>
+#include <thread>
+#include <csignal>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include <opencv2/opencv.hpp>
+#include <opencv2/videoio/videoio_c.h>
+
+#include "../shm_ring.hpp"
+
+static volatile std::sig_atomic_t stopRequested = 0;
+
+static void onSignal(int) {
+    stopRequested = 1;
+}
+
+int main(int argc, char *argv[]) {
+    const std::string usage = std::string("Usage: ") + argv[0] + " <video file|cam> <shm name> [slots] [fps] [loops]";
+    if (argc < 3) {
+        std::cerr << usage << std::endl;
+        return 1;
+    }
+    const std::string input = argv[1];
+    const std::string name = argv[2];
+    // a ring needs at least one slot, frame N goes to slot N % slotCount
+    const long slots = argc > 3 ? std::strtol(argv[3], nullptr, 10) : 4;
+    if (slots < 1 || slots > UINT32_MAX) {
+        std::cerr << "Number of slots should be at least 1" << std::endl << usage << std::endl;
+        return 1;
+    }
+    const uint32_t slotCount = static_cast<uint32_t>(slots);
+    const int loops = argc > 5 ? std::stoi(argv[5]) : 1;
+
+    cv::VideoCapture cap;
+    if (!(input == "cam" ? cap.open(0) : cap.open(input))) {
+        std::cerr << "Cannot open input file or camera: " << input << std::endl;
+        return 1;
+    }
+    cv::Mat frame;
+    if (!cap.read(frame) || frame.type() != CV_8UC3) {
+        std::cerr << "Failed to get a BGR frame from " << input << std::endl;
+        return 1;
+    }
+    const double sourceFps = cap.get(CV_CAP_PROP_FPS);
+    const double fps = argc > 4 ? std::stod(argv[4]) : sourceFps;
+
+    const uint32_t width = frame.cols;
+    const uint32_t height = frame.rows;
+    const uint32_t stride = static_cast<uint32_t>(ShmRingLayout::alignUp(width * 3));
+    const size_t size = ShmRingLayout::segmentSize(stride, height, slotCount);
+
+    int fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0 || ftruncate(fd, size) != 0) {
+        std::cerr << "Cannot create shared memory " << name << ": " << std::strerror(errno) << std::endl;
+        return 1;
+    }
+    void *mapped = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mapped == MAP_FAILED) {
+        std::cerr << "Cannot map shared memory " << name << ": " << std::strerror(errno) << std::endl;
+        shm_unlink(name.c_str());
+        return 1;
+    }
+
+    // ftruncate zero-fills the segment, so all slots start out empty
+    ShmRingHeader *ring = static_cast<ShmRingHeader *>(mapped);
+    ring->width = width;
+    ring->height = height;
+    ring->stride = stride;
+    ring->slotCount = slotCount;
+    ring->slotSize = ShmRingLayout::slotSize(stride, height);
+    ring->dataOffset = ShmRingLayout::alignUp(sizeof(ShmRingHeader));
+    ring->fps = fps > 0 ? fps : sourceFps;
+    ring->version = shmRingVersion;
+    std::atomic_thread_fence(std::memory_order_release);
+    ring->magic = shmRingMagic;
+
+    std::signal(SIGINT, onSignal);
+    std::signal(SIGTERM, onSignal);
+
+    std::cout << "Publishing " << width << "x" << height << " frames from " << input << " to " << name
+              << " (" << slotCount << " slots)" << std::endl;
+
+    const auto start = std::chrono::steady_clock::now();
+    const auto period = std::chrono::duration<double>(fps > 0 ? 1.0 / fps : 0.0);
+    uint64_t sequence = 0;
+    for (int loop = 0; loop < loops && !stopRequested; loop++) {
+        if (loop > 0) {
+            cap.set(CV_CAP_PROP_POS_FRAMES, 0);
+            if (!cap.read(frame)) break;
+        }
+        do {
+            if (frame.cols != static_cast<int>(width) || frame.rows != static_cast<int>(height)) {
+                std::cerr << "Frame size changed, stopping" << std::endl;
+                stopRequested = 1;
+                break;
+            }
+            sequence++;
+            std::this_thread::sleep_until(start + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                period * static_cast<double>(sequence - 1)));
+
+            ShmSlotHeader *slot = ShmRingLayout::slot(ring, sequence);
+            slot->sequence.store(0, std::memory_order_release);
+            std::atomic_thread_fence(std::memory_order_release);
+            cv::Mat target(height, width, CV_8UC3, ShmRingLayout::pixels(slot), stride);
+            frame.copyTo(target);
+            slot->timestampMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+            slot->sequence.store(sequence, std::memory_order_release);
+            ring->writeSequence.store(sequence, std::memory_order_release);
+        } while (!stopRequested && cap.read(frame));
+    }
+
+    ring->producerClosed.store(1, std::memory_order_release);
+    std::cout << "Published " << sequence << " frames" << std::endl;
+
+    // give consumers a moment to notice the closed flag before the name disappears
+    std::this_thread::sleep_for(std::chrono::seconds(1));
+    munmap(mapped, size);
+    shm_unlink(name.c_str());
+    return 0;
+}
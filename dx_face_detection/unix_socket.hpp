@@ -0,0 +1,112 @@
+/*
+// Copyright (c) 2018 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma once
+
+/**
+* \brief Minimal helpers for the length-prefixed messages exchanged over Unix domain sockets.
+* Every message is a host byte order uint32 length followed by that many bytes.
+*/
+
+#include <string>
+#include <vector>
+#include <stdexcept>
+#include <cstring>
+#include <cerrno>
+#include <cstdint>
+
+#ifndef _WIN32
+#include <unistd.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+namespace UnixSocket {
+
+/** Creates a listening socket, replacing a stale socket file left behind by an earlier run **/
+inline int listen(const std::string &path, int backlog = 16) {
+    sockaddr_un addr;
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(addr.sun_path)) {
+        throw std::logic_error("Unix socket path is too long: " + path);
+    }
+    std::strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+    ::unlink(path.c_str());
+
+    int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0 || ::bind(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) != 0 || ::listen(fd, backlog) != 0) {
+        std::string error = std::strerror(errno);
+        if (fd >= 0) ::close(fd);
+        throw std::logic_error("Cannot listen on Unix socket " + path + ": " + error);
+    }
+    return fd;
+}
+
+/** Waits up to timeoutMs for a connection, returns -1 on timeout **/
+inline int accept(int listenFd, int timeoutMs) {
+    pollfd pfd = {listenFd, POLLIN, 0};
+    if (::poll(&pfd, 1, timeoutMs) <= 0) {
+        return -1;
+    }
+    return ::accept(listenFd, nullptr, nullptr);
+}
+
+inline bool readExact(int fd, void *data, size_t size) {
+    char *ptr = static_cast<char *>(data);
+    while (size > 0) {
+        ssize_t got = ::recv(fd, ptr, size, 0);
+        if (got < 0 && errno == EINTR) continue;
+        if (got <= 0) return false;
+        ptr += got;
+        size -= got;
+    }
+    return true;
+}
+
+inline bool writeExact(int fd, const void *data, size_t size) {
+    const char *ptr = static_cast<const char *>(data);
+    while (size > 0) {
+        ssize_t sent = ::send(fd, ptr, size, MSG_NOSIGNAL);
+        if (sent < 0 && errno == EINTR) continue;
+        if (sent <= 0) return false;
+        ptr += sent;
+        size -= sent;
+    }
+    return true;
+}
+
+/** Reads one message, returns false when the peer closed the connection or sent more than maxSize **/
+inline bool readMessage(int fd, std::vector<unsigned char> &message, uint32_t maxSize) {
+    uint32_t size = 0;
+    if (!readExact(fd, &size, sizeof(size)) || size > maxSize) {
+        return false;
+    }
+    message.resize(size);
+    return readExact(fd, message.data(), size);
+}
+
+inline bool writeMessage(int fd, const std::string &message) {
+    uint32_t size = static_cast<uint32_t>(message.size());
+    return writeExact(fd, &size, sizeof(size)) && writeExact(fd, message.data(), message.size());
+}
+
+}  // namespace UnixSocket
+#endif
@@ -0,0 +1,101 @@
+/*
+// Copyright (c) 2018 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+#pragma once
+
+#include <vector>
+#include <functional>
+#include <mutex>
+#include <algorithm>
+#include <cstdint>
+
+#include "results_writer.hpp"
+
+/// @brief Frames [begin, end) of a video file processed by one worker
+struct VideoSegment {
+    int64_t begin = 0;
+    int64_t end = 0;
+};
+
+/**
+* \brief Splits frameCount frames into about count segments of similar length. Boundaries are rounded to
+* multiples of gop, so with a fixed keyframe interval every segment starts on a keyframe and a worker
+* seeking to it does not decode frames of the previous segment. A gop of 0 or 1 keeps exact boundaries.
+*/
+inline std::vector<VideoSegment> planSegments(int64_t frameCount, size_t count, int64_t gop) {
+    std::vector<VideoSegment> segments;
+    if (frameCount <= 0 || count == 0) {
+        return segments;
+    }
+    gop = std::max<int64_t>(1, gop);
+    int64_t begin = 0;
+    for (size_t s = 1; s <= count && begin < frameCount; s++) {
+        int64_t end = frameCount * static_cast<int64_t>(s) / static_cast<int64_t>(count);
+        end = s == count ? frameCount : std::min(frameCount, (end + gop / 2) / gop * gop);
+        if (end > begin) {
+            VideoSegment segment;
+            segment.begin = begin;
+            segment.end = end;
+            segments.push_back(segment);
+            begin = end;
+        }
+    }
+    return segments;
+}
+
+/**
+* \brief Hands the records of segments that finish in any order on to sink in frame order.
+* Records of a segment are held back until all earlier segments completed. Safe to call from the workers.
+*/
+class OrderedSegmentMerger {
+public:
+    OrderedSegmentMerger(size_t segments, const std::function<void(FrameRecord &&)> &sink)
+        : _sink(sink), _completed(segments, false), _records(segments) {}
+
+    void complete(size_t segment, std::vector<FrameRecord> &&records) {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _records[segment] = std::move(records);
+        _completed[segment] = true;
+
+        while (_next < _completed.size() && _completed[_next]) {
+            for (auto &&record : _records[_next]) {
+                _sink(std::move(record));
+            }
+            std::vector<FrameRecord>().swap(_records[_next]);
+            _next++;
+        }
+
+        size_t pending = 0;
+        for (size_t s = _next; s < _completed.size(); s++) {
+            pending += _completed[s] ? 1 : 0;
+        }
+        _maxPending = std::max(_maxPending, pending);
+    }
+
+    /** Largest number of completed segments that waited for an earlier one **/
+    size_t maxPending() const {
+        return _maxPending;
+    }
+
+private:
+    std::function<void(FrameRecord &&)> _sink;
+    std::mutex _mutex;
+    std::vector<bool> _completed;
+    std::vector<std::vector<FrameRecord>> _records;
+    size_t _next = 0;
+    size_t _maxPending = 0;
+};